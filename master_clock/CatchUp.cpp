@@ -0,0 +1,70 @@
+/*
+    Master Clock - Drives an IBM Impulse Secondary clock movement
+    using the International Business Machine Time Protocols,
+    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+    By Phil Hord,  This code is in the public domain Sept 9, 2013
+*/
+
+//_____________________________________________________________________
+//                                                             INCLUDES
+#include "Arduino.h"
+#include "clock_generic.h"
+#include "Config.h"
+#include "CatchUp.h"
+#include "Protocol.h"
+
+unsigned pulsesPerSecond() {
+  auto & config = getConfig() ;
+  unsigned n = 1000 / ( config.riseMs + config.fallMs ) ;
+  return n ? n : 1 ;
+}
+
+//_____________________________________
+// The face is on time when delta is 0, at the second its next minute
+// is due, or when it already shows the current minute after second 0 of
+// it, which puts delta in the last minute before MAX_TIME.  At second 0
+// itself such a face must skip its pulse, a wait of no seconds.  Any
+// other delta leaves the face delta / 60 + 1 minutes slow.
+//
+// Each second spent running moves the face `rate` minutes and real time
+// one second; each second spent waiting moves only real time, until it
+// reaches the minute the face shows.
+CatchUpPlan planCatchUp( unsigned delta ) {
+  CatchUpPlan plan = { false , false , 0 , 0 } ;
+  if ( delta == 0 || delta > MAX_TIME - 60 ) return plan ;
+
+  unsigned long rate = pulsesPerSecond() ;
+  unsigned long behind = delta + 60 ;                   // Seconds to make up
+  unsigned long run = ( behind + rate * 60 - 2 ) / ( rate * 60 - 1 ) ;
+  unsigned long wait = MAX_TIME - 60 - delta ;
+
+  if ( wait < run ) {
+    plan.wait = true ;
+    plan.seconds = wait ;
+    return plan ;
+  }
+
+  // Don't overshoot in the last second: send only the minutes the face
+  // is short of now.
+  plan.pulses = delta / 60 + 1 ;
+  if ( plan.pulses > rate ) plan.pulses = rate ;
+  plan.seconds = run ;
+  return plan ;
+}
+
+//_____________________________________
+// A face that would run rides the schedule instead if the schedule alone
+// brings it right before the minute is out, even if that takes a few
+// seconds longer than running.
+CatchUpPlan planCatchUp( unsigned face , unsigned now ) {
+  auto plan = planCatchUp( ( MAX_TIME + now - ( face * 60 + 60 ) ) % MAX_TIME ) ;
+  if ( !plan.pulses ) return plan ;
+
+  unsigned ride = ClockProtocol::scheduleCatchUp( face , now ) ;
+  if ( !ride ) return plan ;
+
+  plan.ride = true ;
+  plan.pulses = 0 ;
+  plan.seconds = ride ;
+  return plan ;
+}
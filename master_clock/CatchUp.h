@@ -0,0 +1,38 @@
+// CatchUp.h
+//
+// Plan the quickest way to bring the clock face back to real time
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// A wrong clock can be fixed two ways.  It can run forward, gaining
+// one minute per catch-up pulse while real time moves on, or it can
+// stop and wait for real time to catch up with it.  Running may mean
+// going all the way around the dial, but with fast pulses that is often
+// quicker than waiting out even a few minutes.
+//
+// A protocol with its own correction can also fix a slightly slow face:
+// the IBM minute 59 burst steps a face in :49-:58 up to :59.  When that
+// brings the face right within the minute, the face rides it instead of
+// running.  Catch-up pulses step every movement on the line, while the
+// burst leaves alone the ones already right.
+
+struct CatchUpPlan {
+        bool wait ;             ///< Stop and let real time catch up
+        bool ride ;             ///< Let the schedule's own correction step the face
+        unsigned pulses ;       ///< Catch-up pulses to send this second
+        unsigned long seconds ; ///< Expected seconds until the clock is right
+} ;
+
+// Plan a correction.  `delta` is how far real time is ahead of the
+// minute the face shows next, as computed in markTime(), in seconds.
+CatchUpPlan planCatchUp( unsigned delta ) ;
+
+// Plan a correction for a face showing minute `face` at second `now` of
+// the dial, riding the protocol's correction where it can
+CatchUpPlan planCatchUp( unsigned face , unsigned now ) ;
+
+// Catch-up pulses that fit in one second with the configured timing
+unsigned pulsesPerSecond() ;
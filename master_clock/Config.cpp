@@ -0,0 +1,95 @@
+/*
+    Master Clock - Drives an IBM Impulse Secondary clock movement
+    using the International Business Machine Time Protocols,
+    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+    By Phil Hord,  This code is in the public domain Sept 9, 2013
+*/
+
+//_____________________________________________________________________
+//                                                             INCLUDES
+#include <FS.h>
+#include <LittleFS.h>
+#include <stddef.h>
+
+#include "Arduino.h"
+#include "console.h"
+#include "Config.h"
+#include "TimeSave.h"
+#include "Protocol.h"
+
+#define CONFIG_FILE "config.bin"
+#define CONFIG_VERSION 1
+
+// Catch-up pulses run back to back within each second, so a whole pulse
+// must fit in one.  Below 50ms the movement can't follow.
+#define MIN_PULSE_MS    50
+#define MAX_PERIOD_MS   1000
+
+//_____________________________________________________________________
+//                                                           LOCAL VARS
+
+struct StoredConfig {
+        uint16_t version ;
+        ClockConfig config ;
+        uint16_t crc ;          ///< CRC-16 of the fields above
+} ;
+
+// Same timing as the normal protocol pulses
+static const ClockConfig defaults = { ClockProtocol::Policy::riseMs , ClockProtocol::Policy::fallMs } ;
+
+static ClockConfig config = defaults ;
+
+static bool valid( unsigned riseMs , unsigned fallMs ) {
+  return riseMs >= MIN_PULSE_MS && fallMs >= MIN_PULSE_MS &&
+         riseMs + fallMs <= MAX_PERIOD_MS ;
+}
+
+void configSetup() {
+  if ( !LittleFS.begin() ) return ;
+
+  File file = LittleFS.open( CONFIG_FILE , "r" ) ;
+  if ( !file ) return ;
+
+  StoredConfig stored ;
+  bool ok = file.read( (uint8_t *) &stored , sizeof(stored) ) == sizeof(stored) ;
+  file.close() ;
+
+  if ( !ok || stored.version != CONFIG_VERSION ||
+       stored.crc != crc16( (const uint8_t *) &stored , offsetof(StoredConfig, crc) ) ) {
+    plog( LOG_ERROR , "Bad " CONFIG_FILE "; using defaults\n" ) ;
+    return ;
+  }
+  if ( valid( stored.config.riseMs , stored.config.fallMs ) )
+    config = stored.config ;
+}
+
+static bool saveConfig() {
+  if ( !LittleFS.begin() ) return false ;
+
+  StoredConfig stored ;
+  memset( &stored , 0 , sizeof(stored) ) ;
+  stored.version = CONFIG_VERSION ;
+  stored.config = config ;
+  stored.crc = crc16( (const uint8_t *) &stored , offsetof(StoredConfig, crc) ) ;
+
+  File file = LittleFS.open( CONFIG_FILE , "w" ) ;
+  if ( !file ) return false ;
+  bool ok = file.write( (const uint8_t *) &stored , sizeof(stored) ) == sizeof(stored) ;
+  file.close() ;
+  return ok ;
+}
+
+const ClockConfig & getConfig() {
+  return config ;
+}
+
+bool setPulseTiming( unsigned riseMs , unsigned fallMs ) {
+  if ( !valid( riseMs , fallMs ) ) return false ;
+  config.riseMs = riseMs ;
+  config.fallMs = fallMs ;
+  return saveConfig() ;
+}
+
+void showConfig() {
+  p( "\nCatch-up pulse: %ums on, %ums off\n" , config.riseMs , config.fallMs ) ;
+}
@@ -0,0 +1,27 @@
+// Config.h
+//
+// Per-installation settings, kept in flash
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+
+#include <stdint.h>
+
+struct ClockConfig {
+        uint16_t riseMs ;       ///< Catch-up pulse width
+        uint16_t fallMs ;       ///< Shortest gap between catch-up pulses
+} ;
+
+// Load the settings from flash, or use the defaults
+void configSetup() ;
+
+const ClockConfig & getConfig() ;
+
+// Change the catch-up pulse timing and save it.  Returns false if the
+// movement can't be driven that way.
+bool setPulseTiming( unsigned riseMs , unsigned fallMs ) ;
+
+// Show the settings on the console
+void showConfig() ;
@@ -0,0 +1,127 @@
+/*
+    Master Clock - Drives an IBM Impulse Secondary clock movement
+    using the International Business Machine Time Protocols,
+    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+    By Phil Hord,  This code is in the public domain Sept 9, 2013
+*/
+
+//_____________________________________________________________________
+//                                                             INCLUDES
+#include <FS.h>
+#include <LittleFS.h>
+#include <stddef.h>
+
+#include "Arduino.h"
+#include "console.h"
+#include "Holdover.h"
+#include "TimeSave.h"
+#include "Timer.h"
+
+#define DRIFT_FILE "drift.bin"
+#define DRIFT_VERSION 1
+
+#define MIN_INTERVAL_S    60            // Shorter intervals are mostly network jitter
+#define MAX_DRIFT_PPB     500000L       // Limit of the correction, as adjtime()
+#define MAX_RESIDUAL_PPB  100000L       // Beyond any crystal: a reference step, not drift
+#define UNKNOWN_ERROR_PPB 30000L        // Error of an untrained crystal
+#define MIN_ERROR_PPB     200L          // Best the estimate is ever trusted to be
+#define SAVE_PPB          100L          // Save once the estimate moves this far
+#define SAVE_INTERVAL_S   3600          // but no more often than this
+
+//_____________________________________________________________________
+//                                                           LOCAL VARS
+
+struct StoredDrift {
+  uint16_t version ;
+  int32_t driftPpb ;
+  int32_t errorPpb ;
+  uint16_t crc ;                ///< CRC-16 of the fields above
+} ;
+
+static long drift = 0 ;                         ///< Estimated frequency error
+static long driftError = UNKNOWN_ERROR_PPB ;    ///< How far it may be off
+static bool trained = false ;                   ///< drift has been estimated
+static long fraction = 0 ;                      ///< Correction carried to the next second, ppb-seconds
+
+static long savedDrift = 0 ;
+static Instant nextSave ;
+
+void holdoverSetup() {
+  if ( !LittleFS.begin() ) return ;
+
+  File file = LittleFS.open( DRIFT_FILE , "r" ) ;
+  if ( !file ) return ;
+
+  StoredDrift stored ;
+  bool ok = file.read( (uint8_t *) &stored , sizeof(stored) ) == sizeof(stored) ;
+  file.close() ;
+
+  if ( !ok || stored.version != DRIFT_VERSION ||
+       stored.crc != crc16( (const uint8_t *) &stored , offsetof(StoredDrift, crc) ) ) {
+    plog( LOG_ERROR , "Bad " DRIFT_FILE "; relearning drift\n" ) ;
+    return ;
+  }
+  drift = savedDrift = stored.driftPpb ;
+  driftError = stored.errorPpb ;
+  trained = true ;
+  p( "Drift: %+ldppb\n" , drift ) ;
+}
+
+static bool saveDrift() {
+  if ( !LittleFS.begin() ) return false ;
+
+  StoredDrift stored ;
+  memset( &stored , 0 , sizeof(stored) ) ;
+  stored.version = DRIFT_VERSION ;
+  stored.driftPpb = drift ;
+  stored.errorPpb = driftError ;
+  stored.crc = crc16( (const uint8_t *) &stored , offsetof(StoredDrift, crc) ) ;
+
+  File file = LittleFS.open( DRIFT_FILE , "w" ) ;
+  if ( !file ) return false ;
+  bool ok = file.write( (const uint8_t *) &stored , sizeof(stored) ) == sizeof(stored) ;
+  file.close() ;
+  return ok ;
+}
+
+void driftUpdate( long offsetUs , long intervalS ) {
+  if ( intervalS < MIN_INTERVAL_S ) return ;
+
+  long residual = (long long) offsetUs * 1000 / intervalS ;
+  if ( labs( residual ) > MAX_RESIDUAL_PPB ) return ;
+
+  // Take the first estimate whole, then follow it a quarter at a time
+  drift += trained ? residual / 4 : residual ;
+  if ( drift > MAX_DRIFT_PPB ) drift = MAX_DRIFT_PPB ;
+  if ( drift < -MAX_DRIFT_PPB ) drift = -MAX_DRIFT_PPB ;
+  trained = true ;
+
+  // What is left over is how wrong the estimate was
+  driftError = ( 3 * driftError + labs( residual ) ) / 4 ;
+  if ( driftError < MIN_ERROR_PPB ) driftError = MIN_ERROR_PPB ;
+
+  if ( labs( drift - savedDrift ) >= SAVE_PPB && reached( nextSave ) ) {
+    if ( saveDrift() ) savedDrift = drift ;
+    else plog( LOG_ERROR , "File write failed: " DRIFT_FILE "\n" ) ;
+    nextSave = monoNow() + secs( SAVE_INTERVAL_S ) ;
+  }
+}
+
+long holdoverStep( long seconds ) {
+  fraction += drift * seconds ;
+  long step = fraction / 1000 ;
+  fraction -= step * 1000 ;
+  return step ;
+}
+
+long driftPpb() {
+  return drift ;
+}
+
+long driftErrorPpb() {
+  return driftError ;
+}
+
+void showDrift() {
+  p( "\nDrift %+ldppb, within %ldppb%s\n" , drift , driftError , trained ? "" : " (untrained)" ) ;
+}
@@ -0,0 +1,37 @@
+// Holdover.h
+//
+// Oscillator drift estimate, kept in flash
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// The ESP crystal runs a few tens of ppm off, which is seconds a day.
+// Each NTP sync tells us how far the clock wandered since the last one;
+// divided by the time between them, that is the frequency error left
+// over.  The estimate is applied as a correction every second, so the
+// clock keeps time through a network outage.  How well the estimate
+// has held up gives the drift error used for the clock's error bound.
+
+#include <stdint.h>
+
+// Load the learned drift from flash
+void holdoverSetup() ;
+
+// Feed the offset the clock gained since the last sync, in
+// microseconds, over an interval in seconds
+void driftUpdate( long offsetUs , long intervalS ) ;
+
+// Microseconds to add to the clock for this many seconds of holdover
+long holdoverStep( long seconds ) ;
+
+// Estimated frequency error of the clock, in parts per billion.
+// Positive means the crystal is slow and the clock is advanced.
+long driftPpb() ;
+
+// How far off the estimate may be, in parts per billion
+long driftErrorPpb() ;
+
+// Report the drift estimate on the console
+void showDrift() ;
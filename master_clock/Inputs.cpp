@@ -0,0 +1,104 @@
+/*
+    Master Clock - Drives an IBM Impulse Secondary clock movement
+    using the International Business Machine Time Protocols,
+    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+    By Phil Hord,  This code is in the public domain Sept 9, 2013
+*/
+
+//_____________________________________________________________________
+//                                                             INCLUDES
+#include "Arduino.h"
+#include "clock_generic.h"
+#include "console.h"
+#include "Inputs.h"
+#include "PulseTimer.h"
+#include "Scheduler.h"
+
+//_____________________________________________________________________
+//                                                            CONSTANTS
+
+#define RUN_DEBOUNCE_MS   30    // Switch contacts settle within this
+#define POWER_DEBOUNCE_MS 500   // Supply must be back this long to count
+
+//_____________________________________________________________________
+//                                                           LOCAL VARS
+
+static int runPin = -1 ;
+static int powerPin = -1 ;
+
+static volatile unsigned long runEdge = 0 ;     ///< micros() of the last RUN edge
+static volatile unsigned runEdges = 0 ;
+static bool runState = false ;                  ///< Debounced RUN level
+
+static volatile unsigned long powerEdge = 0 ;   ///< micros() of the last power edge
+static volatile unsigned long powerFail = 0 ;   ///< micros() of the last falling one
+static volatile unsigned powerFails = 0 ;       ///< Falling power edges
+static volatile unsigned powerEdges = 0 ;
+
+//_____________________________________
+// Pin interrupts: timestamp the edge.  A failing supply stops the pulse
+// timer at once and wakes the power task.
+static void IRAM_ATTR runIsr() {
+  runEdge = micros() ;
+  ++runEdges ;
+}
+
+static void IRAM_ATTR powerIsr() {
+  powerEdge = micros() ;
+  ++powerEdges ;
+  if ( !digitalRead( powerPin ) ) {
+    pulseHold() ;
+    powerFail = powerEdge ;
+    ++powerFails ;
+  }
+  wakeTask( powerService ) ;
+}
+
+void inputsSetup( int run , int power ) {
+  runPin = run ;
+  pinMode( runPin , INPUT_PULLUP ) ;    // Use pullup mode to default HIGH
+  runState = !digitalRead( runPin ) ;
+  attachInterrupt( digitalPinToInterrupt( runPin ) , runIsr , CHANGE ) ;
+
+  powerPin = power ;
+  if ( powerPin < 0 ) return ;
+  pinMode( powerPin , INPUT ) ;
+  attachInterrupt( digitalPinToInterrupt( powerPin ) , powerIsr , CHANGE ) ;
+}
+
+bool runSwitch() {
+  if ( micros() - runEdge >= RUN_DEBOUNCE_MS * 1000UL )
+    runState = !digitalRead( runPin ) ;
+  return runState ;
+}
+
+unsigned long runChangedAt() {
+  return runEdge ;
+}
+
+bool powerWired() {
+  return powerPin >= 0 ;
+}
+
+bool powerFailed() {
+  return powerPin >= 0 && !digitalRead( powerPin ) ;
+}
+
+unsigned powerFailCount() {
+  return powerFails ;
+}
+
+unsigned long powerFailAt() {
+  return powerFail ;
+}
+
+unsigned long powerSettling() {
+  unsigned long steady = ( micros() - powerEdge ) / 1000 ;
+  return steady >= POWER_DEBOUNCE_MS ? 0 : POWER_DEBOUNCE_MS - steady ;
+}
+
+void showInputStats() {
+  p( "\nRUN %s, %u edges\n" , runSwitch() ? "pressed" : "off" , runEdges ) ;
+  if ( powerPin < 0 ) p( "Power fail input not wired\n" ) ;
+  else p( "Power %s, %u fails, %u edges\n" , powerFailed() ? "down" : "up" , powerFails , powerEdges ) ;
+}
@@ -0,0 +1,42 @@
+// Inputs.h
+//
+// Interrupt-driven RUN switch and power-fail inputs
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Both inputs are timestamped in their pin interrupt, so nothing is
+// missed between polls.  The RUN switch reads as its level once it has
+// been steady for RUN_DEBOUNCE_MS.  A power-fail edge holds the pulse
+// timer right in the interrupt, before the supply is gone, and wakes
+// the power task to save the face position.
+
+// Pins are active low.  A power pin of -1 means the supply is not wired
+// to an input.
+void inputsSetup( int runPin , int powerPin ) ;
+
+// The RUN switch is pressed, debounced
+bool runSwitch() ;
+
+// micros() of the last RUN edge, pressed or let go
+unsigned long runChangedAt() ;
+
+// A power-fail input is wired, so a failing supply is caught in time
+bool powerWired() ;
+
+// The clock supply is down now, not debounced
+bool powerFailed() ;
+
+// Power-fail edges seen so far, counting glitches
+unsigned powerFailCount() ;
+
+// micros() of the last power-fail edge
+unsigned long powerFailAt() ;
+
+// Milliseconds until the power input has been steady for POWER_DEBOUNCE_MS
+unsigned long powerSettling() ;
+
+// Report edge counts on the console
+void showInputStats() ;
@@ -0,0 +1,77 @@
+/*
+    Master Clock - Drives an IBM Impulse Secondary clock movement
+    using the International Business Machine Time Protocols,
+    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+    By Phil Hord,  This code is in the public domain Sept 9, 2013
+*/
+
+//_____________________________________________________________________
+//                                                             INCLUDES
+#include <string.h>
+#include "Metrics.h"
+
+//_____________________________________________________________________
+//                                                        METRICS BUFFER
+
+MetricsBuffer::MetricsBuffer( char * buf , size_t size )
+  : buf( buf ) , size( size ) , len( 0 ) , overflow( false ) {
+  if ( size ) buf[0] = 0 ;
+}
+
+// Copy a string in, or mark the buffer full if it doesn't fit.  A
+// line cut short would be a bad scrape, so the partial line is taken
+// back out and nothing is written after that.
+void MetricsBuffer::append( const char * str ) {
+  if ( overflow ) return ;
+  auto n = strlen( str ) ;
+  if ( len + n >= size ) {
+    overflow = true ;
+    while ( len && buf[len - 1] != '\n' ) --len ;
+    if ( size ) buf[len] = 0 ;
+    return ;
+  }
+  memcpy( buf + len , str , n + 1 ) ;
+  len += n ;
+}
+
+void MetricsBuffer::appendNumber( long long value ) {
+  char digits[24] ;
+  char * d = digits + sizeof digits ;
+  *--d = 0 ;
+
+  // Work in the negative range so the most negative value still fits
+  bool negative = value < 0 ;
+  if ( !negative ) value = -value ;
+  do {
+    *--d = '0' - value % 10 ;
+    value /= 10 ;
+  } while ( value ) ;
+  if ( negative ) *--d = '-' ;
+  append( d ) ;
+}
+
+void MetricsBuffer::family( const char * name , const char * type , const char * help ) {
+  append( "# HELP " ) ; append( name ) ; append( " " ) ; append( help ) ;
+  append( "\n# TYPE " ) ; append( name ) ; append( " " ) ; append( type ) ;
+  append( "\n" ) ;
+}
+
+void MetricsBuffer::sample( const char * name , long long value , const char * labels ) {
+  append( name ) ;
+  if ( labels ) {
+    append( "{" ) ; append( labels ) ; append( "}" ) ;
+  }
+  append( " " ) ;
+  appendNumber( value ) ;
+  append( "\n" ) ;
+}
+
+void MetricsBuffer::counter( const char * name , const char * help , long long value ) {
+  family( name , "counter" , help ) ;
+  sample( name , value ) ;
+}
+
+void MetricsBuffer::gauge( const char * name , const char * help , long long value ) {
+  family( name , "gauge" , help ) ;
+  sample( name , value ) ;
+}
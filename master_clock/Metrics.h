@@ -0,0 +1,50 @@
+// Metrics.h
+//
+// Prometheus text format, written into a fixed buffer
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Each module that keeps statistics writes its own metrics, the same
+// way it reports them on the console.  Values are whole numbers in the
+// unit named by the metric, so no floating point formatting is needed.
+// Output that does not fit is dropped and the buffer marked full; it
+// never allocates.
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+
+class MetricsBuffer {
+public:
+  MetricsBuffer( char * buf , size_t size ) ;
+
+  // Start a metric: its HELP and TYPE lines.  type is "counter" or "gauge".
+  void family( const char * name , const char * type , const char * help ) ;
+
+  // One sample of the current metric.  labels is the text between the
+  // braces, like channel="0", or null for none.
+  void sample( const char * name , long long value , const char * labels = nullptr ) ;
+
+  // A metric with a single unlabelled sample
+  void counter( const char * name , const char * help , long long value ) ;
+  void gauge( const char * name , const char * help , long long value ) ;
+
+  const char * text() const { return buf ; }
+  size_t length() const { return len ; }
+  bool full() const { return overflow ; }
+
+private:
+  void append( const char * str ) ;
+  void appendNumber( long long value ) ;
+
+  char * buf ;
+  size_t size ;
+  size_t len ;
+  bool overflow ;
+} ;
+
+#endif
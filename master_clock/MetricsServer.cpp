@@ -0,0 +1,223 @@
+//================================================================================
+// MetricsServer
+//
+// Serves the clock's statistics in the Prometheus text format.  A scrape
+// reads the request line, builds the whole response into one static
+// buffer, then drains it to the socket over as many passes as it takes,
+// like the telnet output queues.  The connection is then left for the
+// client to close, so the loop never waits on a flush.  A client that
+// sends nothing useful, stops reading or never closes is reset after
+// METRICS_TIMEOUT_MS.
+
+#include <ESP8266WiFi.h>
+#include <WiFiServer.h>
+#include <WiFiClient.h>
+
+#include "Arduino.h"
+#include "clock_generic.h"
+#include "console.h"
+#include "Holdover.h"
+#include "Metrics.h"
+#include "MetricsServer.h"
+#include "Network.h"
+#include "NtpClient.h"
+#include "NtpServer.h"
+#include "OutputStage.h"
+#include "Scheduler.h"
+#include "TimeSave.h"
+#include "TimeService.h"
+
+#define METRICS_PORT            80
+// Largest response body: the fixed metrics plus each channel's, with
+// every value at its widest.  One channel needs about 8000 bytes.
+#define METRICS_FIXED_BYTES     7680
+#define METRICS_CHANNEL_BYTES   640
+#define METRICS_BUFFER          ( METRICS_FIXED_BYTES + METRICS_CHANNEL_BYTES * NUM_CHANNELS )
+#define METRICS_REQUEST         32      // Request line bytes kept
+#define METRICS_TIMEOUT_MS      2000    // Drop a client that takes this long
+
+static WiFiServer metrics_server( METRICS_PORT ) ;
+static WiFiClient client ;
+static bool started = false ;
+
+static enum { IDLE , READING , SENDING , CLOSING } state = IDLE ;
+static unsigned long since ;            ///< millis() when the client connected
+static char request[METRICS_REQUEST] ;  ///< Start of the request line
+static unsigned requestLen ;
+static unsigned lineLen ;               ///< Characters in the header line being read
+static bool firstLine ;                 ///< Still reading the request line
+
+static char head[96] ;                  ///< Status line and headers
+static char body[METRICS_BUFFER] ;
+static unsigned headLen , bodyLen ;
+static unsigned sent ;                  ///< Bytes of head, then body, written
+
+static unsigned long scrapes = 0 ;      ///< Metrics responses sent
+static unsigned long notFound = 0 ;     ///< Requests for anything else
+static unsigned long dropped = 0 ;      ///< Clients that timed out
+static unsigned long truncated = 0 ;    ///< Responses that did not fit the buffer
+
+// Ends a response that did not fit, so the scrape shows it was cut short
+static const char TRUNCATED[] = "# Truncated: raise METRICS_BUFFER\n" ;
+static unsigned long buildLast = 0 , buildWorst = 0 ;  ///< Microseconds to build
+
+void setupMetricsServer()
+{
+    if ( state != IDLE ) client.abort() ;
+    state = IDLE ;
+    metrics_server.begin() ;
+    metrics_server.setNoDelay( true ) ;
+    started = true ;
+}
+
+// Metrics kept here, or read from modules that only have accessors
+static void writeSystemMetrics( MetricsBuffer & m )
+{
+    m.gauge( "clock_uptime_seconds" , "Seconds since boot" , millis() / 1000 ) ;
+    m.gauge( "clock_free_heap_bytes" , "Free heap" , ESP.getFreeHeap() ) ;
+    m.gauge( "clock_wifi_rssi_dbm" , "WiFi signal strength" , WiFi.RSSI() ) ;
+    m.gauge( "clock_loop_microseconds" , "Time spent running tasks in the last scheduler pass" , getLoopTime() ) ;
+    m.gauge( "clock_loop_worst_microseconds" , "Longest scheduler pass" , getLoopWorst() ) ;
+    m.gauge( "clock_wakeups_per_second" , "Scheduler wakeups in the last second" , getWakeupRate() ) ;
+
+    auto & ntp = getNtpStatus() ;
+    m.gauge( "clock_synced" , "1 if the clock has been set from NTP" , TimeService::hasBeenSynced() ) ;
+    m.gauge( "clock_stale" , "1 if the clock error bound is too large to serve time" , TimeService::isStale() ) ;
+    m.gauge( "clock_since_update_seconds" , "Seconds since the last NTP update" , TimeService::timeSinceUpdate() ) ;
+    m.gauge( "clock_error_bound_microseconds" , "Bound on the clock error, growing with the drift error" , TimeService::errorBound() ) ;
+    m.gauge( "ntp_stratum" , "Stratum of the chosen server" , ntp.stratum ) ;
+    m.gauge( "ntp_offset_microseconds" , "Last chosen offset, server minus clock" , ntp.offsetUs ) ;
+    m.gauge( "ntp_delay_microseconds" , "Round trip of the chosen sample" , ntp.delayUs ) ;
+    m.gauge( "ntp_jitter_microseconds" , "RMS spread of the chosen server's samples" , ntp.jitterUs ) ;
+    m.gauge( "ntp_slew_microseconds" , "Correction still being slewed out" , ntp.slewUs ) ;
+    m.gauge( "clock_drift_ppb" , "Estimated oscillator frequency error" , driftPpb() ) ;
+    m.gauge( "clock_drift_error_ppb" , "Uncertainty of the drift estimate" , driftErrorPpb() ) ;
+
+    m.counter( "metrics_scrapes_total" , "Metrics responses sent" , scrapes ) ;
+    m.counter( "metrics_truncated_total" , "Responses cut short by the buffer" , truncated ) ;
+    m.gauge( "metrics_build_microseconds" , "Time to build the previous response" , buildLast ) ;
+}
+
+// Build the response for the request line we kept
+static void respond()
+{
+    bool metrics = !strncmp( request , "GET /metrics" , 12 ) &&
+                   ( request[12] == ' ' || request[12] == '?' || !request[12] ) ;
+
+    if ( metrics ) {
+        auto start = micros() ;
+        MetricsBuffer m( body , sizeof body - ( sizeof TRUNCATED - 1 ) ) ;
+        writeClockMetrics( m ) ;
+        writeSaveMetrics( m ) ;
+        writeOutputMetrics( m ) ;
+        writeNtpServerMetrics( m ) ;
+        writeNetworkMetrics( m ) ;
+        writeSystemMetrics( m ) ;
+        bodyLen = m.length() ;
+        if ( m.full() ) {
+            memcpy( body + bodyLen , TRUNCATED , sizeof TRUNCATED ) ;
+            bodyLen += sizeof TRUNCATED - 1 ;
+            ++truncated ;
+            plog( LOG_ERROR , "\nMetrics response truncated at %u bytes\n" , bodyLen ) ;
+        }
+        ++scrapes ;
+        buildLast = micros() - start ;
+        if ( buildLast > buildWorst ) buildWorst = buildLast ;
+
+        headLen = snprintf( head , sizeof head ,
+                            "HTTP/1.0 200 OK\r\n"
+                            "Content-Type: text/plain; version=0.0.4\r\n"
+                            "Connection: close\r\n"
+                            "Content-Length: %u\r\n\r\n" , bodyLen ) ;
+    } else {
+        ++notFound ;
+        bodyLen = 0 ;
+        headLen = snprintf( head , sizeof head ,
+                            "HTTP/1.0 404 Not Found\r\n"
+                            "Connection: close\r\n"
+                            "Content-Length: 0\r\n\r\n" ) ;
+    }
+    sent = 0 ;
+    state = SENDING ;
+}
+
+// Read the request up to the blank line after the headers.  Only the
+// start of the request line is kept.
+static void readRequest()
+{
+    while ( client.available() ) {
+        int ch = client.read() ;
+        if ( ch < 0 ) break ;
+        if ( ch == '\r' ) continue ;
+        if ( ch != '\n' ) {
+            if ( firstLine && requestLen < sizeof request - 1 ) request[requestLen++] = ch ;
+            ++lineLen ;
+            continue ;
+        }
+        if ( !lineLen && !firstLine ) {
+            request[requestLen] = 0 ;
+            respond() ;
+            return ;
+        }
+        firstLine = false ;
+        lineLen = 0 ;
+    }
+}
+
+// Write as much of the response as the socket will take without blocking.
+// Once it is all written, wait for the client to close: stop() would
+// block until the last segment is acknowledged.
+static void sendResponse()
+{
+    while ( sent < headLen + bodyLen ) {
+        int room = client.availableForWrite() ;
+        if ( room <= 0 ) return ;
+
+        const char * from = sent < headLen ? head + sent : body + ( sent - headLen ) ;
+        unsigned n = sent < headLen ? headLen - sent : headLen + bodyLen - sent ;
+        if ( n > (unsigned) room ) n = room ;
+
+        auto wrote = client.write( (const uint8_t *) from , n ) ;
+        if ( !wrote ) return ;
+        sent += wrote ;
+    }
+    state = CLOSING ;
+}
+
+unsigned long serviceMetricsServer()
+{
+    if ( ! started ) return 100 ;
+
+    if ( state != IDLE ) {
+        if ( ! client.connected() ) {
+            client.abort() ;
+            state = IDLE ;
+        } else if ( millis() - since > METRICS_TIMEOUT_MS ) {
+            if ( state != CLOSING ) ++dropped ;
+            client.abort() ;
+            state = IDLE ;
+        }
+    }
+
+    if ( state == IDLE && metrics_server.hasClient() ) {
+        client = metrics_server.available() ;
+        client.setNoDelay( true ) ;
+        since = millis() ;
+        requestLen = lineLen = 0 ;
+        firstLine = true ;
+        state = READING ;
+    }
+
+    if ( state == READING ) readRequest() ;
+    if ( state == SENDING ) sendResponse() ;
+
+    return state == IDLE ? 100 : 20 ;
+}
+
+void showMetricsStats()
+{
+    p( "\nMetrics: %lu scrapes, %lu not found, %lu dropped, %lu truncated\n" ,
+       scrapes , notFound , dropped , truncated ) ;
+    p( "  last response %u of %u bytes, built in %luus, worst %luus\n" ,
+       bodyLen , (unsigned) sizeof body , buildLast , buildWorst ) ;
+}
@@ -0,0 +1,21 @@
+// MetricsServer.h
+//
+// Prometheus metrics over HTTP
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Answers GET /metrics on port 80, one client at a time.  The response
+// is built in a static buffer and written out as fast as the socket
+// takes it, so a scrape never blocks the clock or touches the heap.
+
+void setupMetricsServer() ;
+
+// Accept a scrape and send the response.  Returns milliseconds until
+// it wants to be called again.
+unsigned long serviceMetricsServer() ;
+
+// Report scrape counts and response size on the console
+void showMetricsStats() ;
@@ -1,70 +1,242 @@
-#include <SPI.h>
-#include <WiFiServer.h>
-#include <WiFiUdp.h>
+//================================================================================
+// Network
+//
+// Keeps the WiFi connection up without ever blocking the loop.  Scans
+// run asynchronously, the strongest known network is joined, and the
+// link is watched for drops.  Failed attempts back off exponentially
+// up to NET_BACKOFF_MAX_MS.  Each reconnect restarts mDNS, the telnet
+// and metrics servers and the NTP client, since the address or the
+// route to the time servers may have changed.
+//
+// The pulses are driven by the pulse timer interrupt, so even a slow
+// WiFi call only delays the console, never an edge.  Every call made
+// here returns at once; the state machine polls for the result.
+
 #include <ESP8266WiFi.h>
-#include <WiFiClient.h>
-#include <WiFiClientSecure.h>
-#include <ESP8266WiFiMulti.h>   // Include the Wi-Fi-Multi library
 #include <ESP8266mDNS.h>        // Include the mDNS library
 
-ESP8266WiFiMulti wifiMulti;
-
+#include "Arduino.h"
 #include "clock_generic.h"
-
-#include <ESP8266mDNS.h>
+#include "console.h"
+#include "Metrics.h"
+#include "Network.h"
 
 /* Telnet server machine */
 #include "TelnetServer.h"
 
 /* NTP server machine */
 #include "NtpServer.h"
+#include "NtpClient.h"
+
+/* Prometheus metrics */
+#include "MetricsServer.h"
+
+#define NET_SCAN_TIMEOUT_MS     10000   // Give up on a scan that never finishes
+#define NET_CONNECT_TIMEOUT_MS  15000   // Give up on joining a network
+#define NET_BACKOFF_MIN_MS      1000    // First wait after a failure
+#define NET_BACKOFF_MAX_MS      60000   // Longest wait between attempts
+#define NET_CHECK_MS            500     // Link check interval while up
 
 const char* nodename = "clock1";
 
-bool setupNetwork()
+// Networks we may join; the strongest one in range wins
+struct AccessPoint {
+  const char * ssid ;
+  const char * pass ;
+} ;
+
+static const AccessPoint accessPoints[] = {
+  { "wifi", "ffffffffee" },
+  { "foxland01", "ffffffffee" },
+  { "foxland02", "ffffffffee" },
+};
+
+static enum { NET_INIT, NET_SCAN, NET_SCANNING, NET_CONNECTING, NET_UP, NET_BACKOFF } state = NET_INIT;
+static unsigned long stateSince = 0;    ///< millis() when the state was entered
+static unsigned long backoff = NET_BACKOFF_MIN_MS;  ///< Wait after the next failure
+static unsigned long backoffFor = 0;    ///< Wait in NET_BACKOFF
+static unsigned long attemptStart = 0;  ///< millis() when this connect attempt began
+static unsigned long downSince = 0;     ///< millis() when the link went down
+static const AccessPoint * joined = nullptr;  ///< Network being joined or up
+static bool everUp = false;
+
+static unsigned long scans = 0;         ///< Scans started
+static unsigned long attempts = 0;      ///< Networks joined or tried
+static unsigned long failures = 0;      ///< Attempts that found nothing or timed out
+static unsigned long connects = 0;      ///< Times the link came up
+static unsigned long connectLast = 0, connectWorst = 0;  ///< Milliseconds from scan to up
+static unsigned long outages = 0;       ///< Times the link dropped
+static unsigned long outageLast = 0, outageWorst = 0, outageTotal = 0;  ///< Seconds down
+
+static void enter(decltype(state) next)
+{
+  state = next;
+  stateSince = millis();
+}
+
+// Wait before the next attempt, longer each time it fails
+static void fail()
+{
+  ++failures;
+  backoffFor = backoff;
+  backoff = backoff * 2 > NET_BACKOFF_MAX_MS ? NET_BACKOFF_MAX_MS : backoff * 2;
+  WiFi.disconnect();
+  enter(NET_BACKOFF);
+}
+
+// Join the strongest known network in the scan results.  Returns false
+// if none of them is in range.
+static bool join(int found)
 {
-  static enum {NET_INIT, NET_WAIT, NET_REPORT, NET_FINALIZE, NET_DONE} state = NET_INIT;
-  static int i = 0;
+  const AccessPoint * best = nullptr;
+  int32_t bestRssi = 0;
+  for (int i = 0; i < found; i++) {
+    auto ssid = WiFi.SSID(i);
+    for (auto & ap : accessPoints) {
+      if (strcmp(ssid.c_str(), ap.ssid)) continue;
+      if (!best || WiFi.RSSI(i) > bestRssi) {
+        best = &ap;
+        bestRssi = WiFi.RSSI(i);
+      }
+    }
+  }
+  WiFi.scanDelete();
+  if (!best) return false;
 
-  switch(state) {
+  ++attempts;
+  joined = best;
+  p("\nJoining %s, %ld dBm\n", best->ssid, (long) bestRssi);
+  WiFi.begin(best->ssid, best->pass);
+  return true;
+}
+
+// The link just came up: restart everything that depends on it
+static void linkUp()
+{
+  auto now = millis();
+  connectLast = now - attemptStart;
+  if (connectLast > connectWorst) connectWorst = connectLast;
+  ++connects;
+  backoff = NET_BACKOFF_MIN_MS;
+
+  if (everUp) {
+    outageLast = (now - downSince) / 1000;
+    outageTotal += outageLast;
+    if (outageLast > outageWorst) outageWorst = outageLast;
+  }
+  everUp = true;
+
+  uint32_t ip = WiFi.localIP();
+  p("\nConnected to %s in %lums, IP %u.%u.%u.%u\n", joined->ssid, connectLast,
+    ip & 0xff, (ip >> 8) & 0xff, (ip >> 16) & 0xff, ip >> 24);
+
+  MDNS.end();
+  if (!MDNS.begin(nodename)) plog(LOG_ERROR, "Error setting up MDNS responder!\n");
+
+  NtpSetup();
+  ntpClientRestart();
+  setupTelnetServer();
+  setupMetricsServer();
+}
+
+unsigned long networkService()
+{
+  auto now = millis();
+  auto age = now - stateSince;
+
+  switch (state) {
     case NET_INIT:
-      wifiMulti.addAP("wifi", "ffffffffee");
-      wifiMulti.addAP("foxland01", "ffffffffee");
-      wifiMulti.addAP("foxland02", "ffffffffee");
-      state = NET_WAIT;
-      break;
-
-    case NET_WAIT:
-      if (wifiMulti.run() != WL_CONNECTED) { // Wait for the Wi-Fi to connect: scan for Wi-Fi networks, and connect to the strongest of the networks above
-        showActivity(2);
-        break;
+      // Don't let the SDK write the credentials to flash on every join,
+      // or reconnect behind our back
+      WiFi.persistent(false);
+      WiFi.mode(WIFI_STA);
+      WiFi.hostname(nodename);
+      WiFi.setAutoReconnect(false);
+      attemptStart = now;
+      enter(NET_SCAN);
+      return 0;
+
+    case NET_SCAN:
+      ++scans;
+      WiFi.scanNetworks(true);
+      enter(NET_SCANNING);
+      return 100;
+
+    case NET_SCANNING: {
+      int found = WiFi.scanComplete();
+      if (found == WIFI_SCAN_RUNNING) {
+        if (age < NET_SCAN_TIMEOUT_MS) { showActivity(2); return 100; }
+        fail();
+      } else if (found < 0 || !join(found)) {
+        fail();
+      } else {
+        enter(NET_CONNECTING);
       }
-      state = NET_REPORT;
-      break;
-
-    case NET_REPORT:
-      Serial.println('\n');
-      Serial.print("Connected to ");
-      Serial.println(WiFi.SSID());              // Tell us what network we're connected to
-      Serial.print("IP address:\t");
-      Serial.println(WiFi.localIP());           // Send the IP address of the ESP8266 to the computer
-
-      if (!MDNS.begin(nodename)) {             // Start the mDNS responder for esp8266.local
-        Serial.println("Error setting up MDNS responder!");
+      return 100;
+    }
+
+    case NET_CONNECTING:
+      switch (WiFi.status()) {
+        case WL_CONNECTED:
+          linkUp();
+          enter(NET_UP);
+          return NET_CHECK_MS;
+        case WL_CONNECT_FAILED:
+        case WL_NO_SSID_AVAIL:
+          fail();
+          return 100;
+        default:
+          break;        // Still joining; wait for the connect timeout
       }
-      Serial.println("mDNS responder started");
-      state = NET_FINALIZE;
-      break;
-
-    case NET_FINALIZE:
-      NtpSetup() ;
-      setupTelnetServer();
-      state = NET_DONE;
-
-    case NET_DONE:
-    // TODO: Detect if wifi disconnects and start over
-      break;
+      if (age > NET_CONNECT_TIMEOUT_MS) fail();
+      else showActivity(2);
+      return 100;
+
+    case NET_UP:
+      if (WiFi.status() == WL_CONNECTED) {
+        MDNS.update();
+        return NET_CHECK_MS;
+      }
+      ++outages;
+      downSince = now;
+      p("\nWiFi connection lost\n");
+      backoffFor = 0;
+      WiFi.disconnect();
+      enter(NET_BACKOFF);
+      return 0;
+
+    case NET_BACKOFF:
+      if (age < backoffFor) return backoffFor - age;
+      attemptStart = now;
+      enter(NET_SCAN);
+      return 0;
   }
+  return 100;
+}
+
+bool networkUp()
+{
+  return state == NET_UP;
+}
 
-  return state == NET_DONE;
+void showNetworkStats()
+{
+  static const char * const names[] = { "starting", "scanning", "scanning", "joining", "up", "waiting" };
+  p("\nWiFi %s; %lu scans, %lu joins, %lu failed, backoff %lums\n",
+    names[state], scans, attempts, failures, backoff);
+  p("  %lu connects, last %lums, worst %lums\n", connects, connectLast, connectWorst);
+  p("  %lu outages, last %lus, worst %lus, total %lus\n", outages, outageLast, outageWorst, outageTotal);
+}
+
+void writeNetworkMetrics(MetricsBuffer & m)
+{
+  m.gauge("wifi_up", "1 if the WiFi link is up", networkUp());
+  m.counter("wifi_scans_total", "WiFi scans started", scans);
+  m.counter("wifi_connect_failures_total", "Scans or joins that did not get a link", failures);
+  m.counter("wifi_connects_total", "Times the WiFi link came up", connects);
+  m.gauge("wifi_connect_milliseconds", "Time from scan to link up, last connect", connectLast);
+  m.gauge("wifi_connect_worst_milliseconds", "Longest time to bring the link up", connectWorst);
+  m.counter("wifi_outages_total", "Times the WiFi link dropped", outages);
+  m.counter("wifi_outage_seconds_total", "Seconds spent reconnecting after drops", outageTotal);
+  m.gauge("wifi_outage_worst_seconds", "Longest outage", outageWorst);
 }
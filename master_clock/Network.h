@@ -1,2 +1,13 @@
-// Init network; returns true if successful
-bool setupNetwork();
+// Connect to WiFi and keep the link up.  Returns milliseconds until it
+// wants to be called again.
+unsigned long networkService();
+
+// The link is up and the servers have been started on it
+bool networkUp();
+
+// Report connect times and outages on the console
+void showNetworkStats();
+
+// Write connect times and outages
+class MetricsBuffer;
+void writeNetworkMetrics(MetricsBuffer & m);
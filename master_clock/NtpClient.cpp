@@ -0,0 +1,427 @@
+/*
+    Master Clock - Drives an IBM Impulse Secondary clock movement
+    using the International Business Machine Time Protocols,
+    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+    By Phil Hord,  This code is in the public domain Sept 9, 2013
+*/
+
+//_____________________________________________________________________
+//                                                             INCLUDES
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <lwip/dns.h>
+#include <sys/time.h>
+#include <math.h>
+
+#include "Arduino.h"
+#include "console.h"
+#include "NtpClient.h"
+#include "TimeService.h"
+#include "Timer.h"
+#include "Holdover.h"
+
+//_____________________________________________________________________
+//                                                            CONSTANTS
+
+#define NTP_LOCAL_PORT    4123          // Our end; NTP_PORT is left for the server
+
+#define MAX_SERVERS       4
+#define FILTER_SAMPLES    8             // Samples kept per server
+
+#define NTP_MAX_DELAY_US  500000L       // Drop samples with a longer round trip
+#define NTP_STEP_US       128000L       // Step larger offsets, slew smaller ones
+#define SAMPLE_AGING_PPM  15            // A sample's error grows this fast, as NTP's PHI
+#define SLEW_US           500           // Slew per second, as adjtime() does
+
+#define NTP_TIMEOUT_MS    1000          // Wait this long for each reply
+#define NTP_DNS_WAIT_MS   2000          // Longest a poll waits for server lookups
+#define POLL_UNSYNCED_S   16            // Poll interval until the first sync
+#define POLL_S            64            // Poll interval after it
+
+//_____________________________________________________________________
+//                                                           LOCAL VARS
+
+struct Sample {
+  int64_t offset ;              ///< Server minus us, in microseconds
+  int64_t delay ;               ///< Round trip, in microseconds
+  bool valid ;
+  unsigned long seq ;           ///< Number of the reply it came from
+  Instant at ;                  ///< When it came
+} ;
+
+struct Server {
+  char host[40] ;
+  uint16_t port ;
+  IPAddress ip ;
+  bool resolved ;
+  bool resolving ;              ///< A lookup is under way
+
+  Sample samples[FILTER_SAMPLES] ;
+  unsigned next ;               ///< Slot for the next sample
+  int best ;                    ///< Sample with the shortest round trip, or -1
+  long jitter ;                 ///< RMS offset of the others from the best
+
+  uint8_t stratum ;
+  uint32_t refId ;
+  uint8_t reach ;               ///< One bit per poll, set if it answered
+  unsigned sent , received , rejected ;
+} ;
+
+static Server servers[MAX_SERVERS] ;
+static int serverCount = 0 ;
+
+static enum { NTP_IDLE , NTP_RESOLVE , NTP_SEND , NTP_WAIT } state = NTP_IDLE ;
+static int current = 0 ;                ///< Server being queried
+static uint64_t sentAt ;                ///< Our transmit time, microseconds since 1900
+static uint8_t sentStamp[8] ;           ///< The same, as sent on the wire
+static Instant replyDeadline ;
+static Instant lookupDeadline ;
+static Instant nextPoll ;
+
+static WiFiUDP udp ;
+static bool udpOpen = false ;
+
+static NtpStatus status ;
+static time_t slewSecond = 0 ;          ///< Second of the last slew step
+static Instant lastSync ;               ///< When the last offset was chosen
+static unsigned long replies = 0 ;      ///< Samples taken so far
+static unsigned long usedSeq = 0 ;      ///< Sample the clock was last corrected by
+
+//_____________________________________________________________________
+// Timestamps
+
+// The system clock, in microseconds since 1900
+uint64_t ntpNow() {
+  timeval tv ;
+  gettimeofday( &tv , nullptr ) ;
+  return ( tv.tv_sec + NTP_UNIX_EPOCH ) * 1000000ULL + tv.tv_usec ;
+}
+
+uint32_t ntpReadWord( const uint8_t * p ) {
+  return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3] ;
+}
+
+void ntpWriteWord( uint8_t * p , uint32_t w ) {
+  p[0] = w >> 24 ; p[1] = w >> 16 ; p[2] = w >> 8 ; p[3] = w ;
+}
+
+void ntpWriteStamp( uint8_t * p , uint64_t us ) {
+  ntpWriteWord( p , us / 1000000 ) ;
+  ntpWriteWord( p + 4 , ( ( us % 1000000 ) << 32 ) / 1000000 ) ;
+}
+
+// Read a wire timestamp.  Its 32-bit seconds are taken as the era
+// nearest `near`, so the 2036 rollover is no problem.
+uint64_t ntpReadStamp( const uint8_t * p , uint64_t near ) {
+  uint32_t nearSec = near / 1000000 ;
+  int32_t diff = ntpReadWord( p ) - nearSec ;
+  uint64_t sec = near / 1000000 + diff ;
+  return sec * 1000000 + ( ( (uint64_t) ntpReadWord( p + 4 ) * 1000000 ) >> 32 ) ;
+}
+
+//_____________________________________________________________________
+// Sample filter
+
+// How far a sample may be off: half its round trip, plus what the clock
+// may have wandered since it was taken
+static int64_t sampleDistance( const Sample & sample , Instant now ) {
+  return sample.delay / 2 + ( now - sample.at ).us / 1000000 * SAMPLE_AGING_PPM ;
+}
+
+// Pick the server's closest sample and measure the spread around it
+static void filter( Server & s ) {
+  auto now = monoNow() ;
+  s.best = -1 ;
+  for ( int i = 0 ; i < FILTER_SAMPLES ; i++ ) {
+    if ( !s.samples[i].valid ) continue ;
+    if ( s.best < 0 || sampleDistance( s.samples[i] , now ) < sampleDistance( s.samples[s.best] , now ) ) s.best = i ;
+  }
+  if ( s.best < 0 ) return ;
+
+  double sum = 0 ;
+  int n = 0 ;
+  for ( int i = 0 ; i < FILTER_SAMPLES ; i++ ) {
+    if ( !s.samples[i].valid || i == s.best ) continue ;
+    double d = s.samples[i].offset - s.samples[s.best].offset ;
+    sum += d * d ;
+    ++n ;
+  }
+  s.jitter = n ? (long) sqrt( sum / n ) : 0 ;
+}
+
+// Correct the clock's phase, and every stored offset with it, so old
+// samples keep describing the clock as it is now.  The drift correction
+// doesn't come through here: it makes up for time the clock loses after
+// a sample, which that sample never saw.
+static void moveClock( int64_t us , bool nudge ) {
+  TimeService::shiftClock( us , nudge ) ;
+  for ( int i = 0 ; i < serverCount ; i++ )
+    for ( auto & sample : servers[i].samples )
+      sample.offset -= us ;
+}
+
+//_____________________________________________________________________
+// Queries
+
+// lwIP calls this once a lookup is done, between passes of the loop.
+// A failed lookup is tried again on the next poll.
+static void nameFound( const char * , const ip_addr_t * addr , void * arg ) {
+  auto & s = *(Server *) arg ;
+  s.resolving = false ;
+  if ( !addr ) return ;
+  s.ip = IPAddress( ip_addr_get_ip4_u32( addr ) ) ;
+  s.resolved = true ;
+}
+
+// Start looking the server up, without waiting for the answer.  A
+// dotted quad or a name lwIP has cached comes back at once.
+static void lookUp( Server & s ) {
+  if ( s.resolved || s.resolving ) return ;
+  ip_addr_t addr ;
+  err_t err = dns_gethostbyname( s.host , &addr , nameFound , &s ) ;
+  if ( err == ERR_OK ) {
+    s.ip = IPAddress( ip_addr_get_ip4_u32( &addr ) ) ;
+    s.resolved = true ;
+  }
+  s.resolving = err == ERR_INPROGRESS ;
+}
+
+static bool lookingUp() {
+  for ( int i = 0 ; i < serverCount ; i++ )
+    if ( servers[i].resolving ) return true ;
+  return false ;
+}
+
+static void sendRequest( Server & s ) {
+  s.reach <<= 1 ;
+  if ( !s.resolved ) {
+    state = NTP_SEND ;
+    ++current ;
+    return ;
+  }
+
+  // Drop late replies to earlier queries
+  while ( udp.parsePacket() ) udp.flush() ;
+
+  uint8_t packet[NTP_PACKET] = {} ;
+  packet[0] = ( 4 << 3 ) | 3 ;          // Version 4, client
+  sentAt = ntpNow() ;
+  ntpWriteStamp( packet + 40 , sentAt ) ;
+  memcpy( sentStamp , packet + 40 , sizeof(sentStamp) ) ;
+
+  udp.beginPacket( s.ip , s.port ) ;
+  udp.write( packet , sizeof(packet) ) ;
+  udp.endPacket() ;
+  ++s.sent ;
+
+  replyDeadline = monoNow() + msecs( NTP_TIMEOUT_MS ) ;
+  state = NTP_WAIT ;
+}
+
+// Read a reply from the current server.  Returns false if none came yet.
+static bool readReply( Server & s ) {
+  if ( udp.parsePacket() < NTP_PACKET ) return false ;
+
+  uint8_t packet[NTP_PACKET] ;
+  udp.read( packet , sizeof(packet) ) ;
+  auto arrived = ntpNow() ;
+
+  // It must answer our query, from a server that has the time
+  if ( (uint32_t) udp.remoteIP() != (uint32_t) s.ip || memcmp( packet + 24 , sentStamp , sizeof(sentStamp) ) ) return false ;
+  unsigned leap = packet[0] >> 6 ;
+  unsigned mode = packet[0] & 7 ;
+  unsigned stratum = packet[1] ;
+  if ( mode != 4 || leap == 3 || stratum == 0 || stratum >= 16 ) {
+    ++s.rejected ;
+    return true ;
+  }
+
+  int64_t received = ntpReadStamp( packet + 32 , arrived ) ;
+  int64_t transmit = ntpReadStamp( packet + 40 , arrived ) ;
+  int64_t offset = ( ( received - (int64_t) sentAt ) + ( transmit - (int64_t) arrived ) ) / 2 ;
+  int64_t delay = ( (int64_t) arrived - (int64_t) sentAt ) - ( transmit - received ) ;
+  if ( delay < 0 ) delay = 0 ;
+  if ( delay > NTP_MAX_DELAY_US ) {
+    ++s.rejected ;
+    return true ;
+  }
+
+  s.samples[s.next] = { offset , delay , true , ++replies , monoNow() } ;
+  s.next = ( s.next + 1 ) % FILTER_SAMPLES ;
+  s.stratum = stratum ;
+  s.refId = s.ip ;
+  s.reach |= 1 ;
+  ++s.received ;
+  filter( s ) ;
+  return true ;
+}
+
+//_____________________________________
+// Choose the server with the smallest error estimate, and correct the
+// clock by its offset
+static void finishRound() {
+  Server * chosen = nullptr ;
+  int64_t distance = 0 ;
+  for ( int i = 0 ; i < serverCount ; i++ ) {
+    auto & s = servers[i] ;
+    if ( !( s.reach & 1 ) || s.best < 0 ) continue ;
+    int64_t d = s.samples[s.best].delay / 2 + s.jitter ;
+    if ( !chosen || d < distance ) { chosen = &s ; distance = d ; }
+  }
+  if ( !chosen ) return ;
+
+  auto & best = chosen->samples[chosen->best] ;
+  status.offsetUs = best.offset ;
+  status.delayUs = best.delay ;
+  status.jitterUs = chosen->jitter ;
+  status.stratum = chosen->stratum ;
+  status.refId = chosen->refId ;
+
+  // An old sample still winning the filter was already corrected for;
+  // using it again would count the same offset twice
+  if ( best.seq <= usedSeq ) return ;
+  usedSeq = best.seq ;
+
+  // Whatever the clock gained beyond the slew still under way is
+  // frequency error the drift estimate missed
+  auto now = monoNow() ;
+  bool step = !status.synced || llabs( best.offset ) > NTP_STEP_US ;
+  if ( !step ) driftUpdate( (long) ( best.offset - status.slewUs ) , ( now - lastSync ).us / 1000000 ) ;
+  lastSync = now ;
+
+  if ( step ) {
+    moveClock( best.offset , false ) ;
+    status.slewUs = 0 ;
+    status.synced = true ;
+  } else {
+    status.slewUs = (long) best.offset ;
+  }
+
+  TimeService::noteUpdate( (long) ( best.delay / 2 ) + chosen->jitter , driftErrorPpb() ) ;
+  status.updated = time( nullptr ) ;
+}
+
+//_____________________________________
+// Take one slew step, plus the drift correction for the seconds since
+// the last one.  It happens in the middle of a second so the clock can
+// not be moved across a second boundary.
+static void slew() {
+  if ( !status.synced ) return ;
+
+  timeval tv ;
+  gettimeofday( &tv , nullptr ) ;
+  if ( tv.tv_sec == slewSecond || tv.tv_usec < 200000 || tv.tv_usec > 800000 ) return ;
+  long seconds = slewSecond ? tv.tv_sec - slewSecond : 1 ;
+  slewSecond = tv.tv_sec ;
+  if ( seconds < 1 || seconds > 3600 ) seconds = 1 ;    // The clock was stepped
+
+  long step = status.slewUs ;
+  if ( step > SLEW_US ) step = SLEW_US ;
+  if ( step < -SLEW_US ) step = -SLEW_US ;
+  status.slewUs -= step ;
+
+  if ( step ) moveClock( step , true ) ;
+
+  long drift = holdoverStep( seconds ) ;
+  if ( drift ) TimeService::shiftClock( drift , true ) ;
+}
+
+//_____________________________________________________________________
+
+void ntpClientSetup( const char * const * names , int count ) {
+  TimeService::begin() ;
+  holdoverSetup() ;
+
+  serverCount = 0 ;
+  for ( int i = 0 ; i < count && serverCount < MAX_SERVERS ; i++ ) {
+    auto & s = servers[serverCount++] ;
+    s = Server() ;
+    strncpy( s.host , names[i] , sizeof(s.host) - 1 ) ;
+    s.port = NTP_PORT ;
+    s.best = -1 ;
+
+    char * colon = strchr( s.host , ':' ) ;
+    if ( colon ) {
+      *colon = 0 ;
+      s.port = atoi( colon + 1 ) ;
+    }
+  }
+}
+
+unsigned long ntpClientService() {
+  slew() ;
+
+  // Keep slewing through an outage
+  unsigned long holdover = status.synced ? TimeService::msUntilNextSecond() + 300 : 1000 ;
+  if ( WiFi.status() != WL_CONNECTED || !serverCount ) return holdover ;
+  if ( !udpOpen ) udpOpen = udp.begin( NTP_LOCAL_PORT ) ;
+  if ( !udpOpen ) return holdover ;
+
+  switch ( state ) {
+  case NTP_IDLE :
+    if ( !reached( nextPoll ) ) break ;
+    for ( int i = 0 ; i < serverCount ; i++ ) lookUp( servers[i] ) ;
+    lookupDeadline = monoNow() + msecs( NTP_DNS_WAIT_MS ) ;
+    state = NTP_RESOLVE ;
+    // fall through
+
+  case NTP_RESOLVE :
+    if ( lookingUp() && !reached( lookupDeadline ) ) return 10 ;
+    current = 0 ;
+    state = NTP_SEND ;
+    // fall through
+
+  case NTP_SEND :
+    if ( current < serverCount ) {
+      sendRequest( servers[current] ) ;
+      break ;
+    }
+    finishRound() ;
+    nextPoll = monoNow() + secs( status.synced ? POLL_S : POLL_UNSYNCED_S ) ;
+    state = NTP_IDLE ;
+    break ;
+
+  case NTP_WAIT :
+    if ( readReply( servers[current] ) || reached( replyDeadline ) ) {
+      ++current ;
+      state = NTP_SEND ;
+      return 0 ;
+    }
+    return 10 ;
+  }
+
+  if ( state != NTP_IDLE ) return state == NTP_WAIT ? 10 : 0 ;
+
+  // Sleep until the next poll, or the middle of the next second once synced
+  unsigned long wait = msUntil( nextPoll ) ;
+  return wait < holdover ? wait : holdover ;
+}
+
+void ntpClientRestart() {
+  if ( udpOpen ) udp.stop() ;
+  udpOpen = false ;
+  for ( int i = 0 ; i < serverCount ; i++ ) servers[i].resolved = false ;
+  state = NTP_IDLE ;
+  nextPoll = monoNow() ;
+}
+
+const NtpStatus & getNtpStatus() {
+  return status ;
+}
+
+void showNtpStatus() {
+  p( "\nNTP %s, stratum %u: offset %lldus, delay %lldus, jitter %ldus\n" ,
+     status.synced ? "synced" : "not synced" , status.stratum ,
+     (long long) status.offsetUs , (long long) status.delayUs , status.jitterUs ) ;
+  p( "  error bound %ldus, slewing %ldus\n" , TimeService::errorBound() , status.slewUs ) ;
+  showDrift() ;
+
+  for ( int i = 0 ; i < serverCount ; i++ ) {
+    auto & s = servers[i] ;
+    p( "%s:%u reach %03o, stratum %u, %u sent, %u received\n" ,
+       s.host , s.port , s.reach , s.stratum , s.sent , s.received ) ;
+    if ( s.best >= 0 )
+      p( "  offset %lldus, delay %lldus, jitter %ldus, %u rejected\n" ,
+         (long long) s.samples[s.best].offset , (long long) s.samples[s.best].delay , s.jitter , s.rejected ) ;
+  }
+}
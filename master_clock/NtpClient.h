@@ -0,0 +1,73 @@
+// NtpClient.h
+//
+// SNTP client that sets and slews the system clock
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Every poll queries each configured server once.  Each server keeps
+// its last few samples and trusts the one with the shortest round trip,
+// since queueing delay is what spoils an NTP offset.  The server with
+// the smallest error estimate sets the system offset.  Offsets beyond
+// NTP_STEP_US step the clock; smaller ones are slewed out a fraction of
+// a millisecond per second, in mid-second, so a correction never adds
+// or drops a second under the pulse schedule.  Between polls, and
+// through outages, the drift estimate in Holdover.cpp is applied every
+// second.
+//
+// Server names are looked up without blocking the loop.  Offsets are
+// 64-bit: before the first sync the clock still reads 1970, decades
+// away from the servers.
+
+#include <stdint.h>
+#include <time.h>
+
+// What the client knows about the time
+struct NtpStatus {
+        bool synced ;           ///< The clock has been set from a server
+        uint8_t stratum ;       ///< Stratum of the chosen server
+        uint32_t refId ;        ///< Its address, as the reference ID of our replies
+        int64_t offsetUs ;      ///< Last chosen offset, server minus us
+        int64_t delayUs ;       ///< Round trip of the chosen sample
+        long jitterUs ;         ///< RMS spread of the chosen server's samples
+        long slewUs ;           ///< Correction still being slewed out
+        time_t updated ;        ///< When the last offset was chosen
+} ;
+
+// Set the servers to query.  Each name may end in ":port", so a local
+// stand-in server can be used for testing.  The strings must stay put.
+void ntpClientSetup( const char * const * servers , int count ) ;
+
+// Poll the servers and slew the clock.  Returns milliseconds until it
+// wants to be called again.
+unsigned long ntpClientService() ;
+
+// Start over on a new network link: reopen the socket, look the
+// servers up again and poll them right away
+void ntpClientRestart() ;
+
+const NtpStatus & getNtpStatus() ;
+
+// Report the servers and the system offset on the console
+void showNtpStatus() ;
+
+//________________________________________________________________
+// Wire format, shared with the NTP server
+
+#define NTP_PORT        123
+#define NTP_PACKET      48              // Header without extensions
+#define NTP_UNIX_EPOCH  2208988800ULL   // 1970 in seconds since 1900
+
+// The system clock, in microseconds since 1900
+uint64_t ntpNow() ;
+
+uint32_t ntpReadWord( const uint8_t * p ) ;
+void ntpWriteWord( uint8_t * p , uint32_t w ) ;
+
+// Write a 64-bit timestamp
+void ntpWriteStamp( uint8_t * p , uint64_t us ) ;
+
+// Read a 64-bit timestamp, in the era nearest `near`
+uint64_t ntpReadStamp( const uint8_t * p , uint64_t near ) ;
@@ -1,25 +1,173 @@
 /**
  * NTP service state machine.
  *
- * Syncrhonizes time with NTP server once per hour.
- * Allows user to initiate one-off synchronization
- * as needed.
+ * Watches the time sync, and answers SNTP requests from the LAN with
+ * our own time.  The master clock is the building's time reference, so
+ * other machines can follow the same clock the slave clocks show.
+ *
+ * The receive timestamp is taken as soon as a request is seen and the
+ * transmit timestamp right before the reply goes out.  Requests are
+ * answered from one static buffer, a few per pass, so a burst of
+ * clients costs no allocation.
  */
 
 //_____________________________________________________________________
 //                                                             INCLUDES
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
 #include "Arduino.h"
 #include "TimeService.h"
 #include "clock_generic.h"
+#include "console.h"
+#include "NtpClient.h"
+#include "NtpServer.h"
+#include "Timer.h"
+#include "Metrics.h"
+
+//_____________________________________________________________________
+//                                                            CONSTANTS
+
+#define NTP_BURST       8       // Most requests answered per pass
+#define NTP_PRECISION   -20     // log2 of the clock resolution, about 1us
+#define NTP_PHI_PPM     15      // Assumed frequency error, for the dispersion
 
+//_____________________________________________________________________
+//                                                           LOCAL VARS
+
+static WiFiUDP udp ;
+static bool listening = false ;
+static uint8_t packet[NTP_PACKET] ;     ///< The request, turned into the reply
+
+static unsigned long requests = 0 ;     ///< Requests answered
+static unsigned long ignored = 0 ;      ///< Packets that were not client requests
+static unsigned requestRate = 0 ;       ///< Requests answered last second
+static unsigned requestCount = 0 ;      ///< Requests answered this second
+static Instant rateSecond ;             ///< Start of the counting window
+
+// Receive to transmit timestamp, in microseconds
+static unsigned long latencyLast = 0 , latencyWorst = 0 , latencyTotal = 0 ;
+
+// Called on every link-up.  The socket from the last link is gone.
 void NtpSetup()
 {
         TimeService::begin();
+        if (listening) udp.stop();
+        listening = false;
+}
+
+// Seconds as NTP short format, 16.16 fixed point
+static uint32_t shortFormat(long us)
+{
+        if (us < 0) us = 0;
+        return ((uint64_t) us << 16) / 1000000;
+}
+
+//_____________________________________
+// Turn the request in `packet` into our reply.  `received` is when it
+// arrived, in microseconds since 1900.
+static void fillReply(uint64_t received)
+{
+        auto & sync = getNtpStatus();
+        bool good = sync.synced && !TimeService::isStale();
+        unsigned version = (packet[0] >> 3) & 7;
+
+        // Clients copy our transmit time back as their origin
+        memcpy(packet + 24, packet + 40, 8);
+
+        packet[0] = (good ? 0 : 3) << 6 | version << 3 | 4;     // Alarm until synced; server
+        packet[1] = !good ? 16 : sync.stratum < 15 ? sync.stratum + 1 : 15;
+        // packet[2], the poll interval, is echoed back
+        packet[3] = (uint8_t) NTP_PRECISION;
+
+        // Errors inherited from upstream, growing with the time since the last sync
+        long age = time(nullptr) - sync.updated;
+        ntpWriteWord(packet + 4, shortFormat((long) sync.delayUs));
+        ntpWriteWord(packet + 8, shortFormat(sync.jitterUs + age * NTP_PHI_PPM));
+        ntpWriteWord(packet + 12, good ? sync.refId : 0);
+
+        // The reference time is the last sync; an NTP era holds until 2036
+        ntpWriteStamp(packet + 16, (sync.updated + NTP_UNIX_EPOCH) * 1000000);
+        ntpWriteStamp(packet + 32, received);
+}
+
+//_____________________________________
+// Answer one waiting request.  Returns false if there is none.
+static bool serveRequest()
+{
+        int len = udp.parsePacket();
+        if (len <= 0) return false;
+        auto received = ntpNow();
+
+        if (len < NTP_PACKET || udp.read(packet, NTP_PACKET) != NTP_PACKET || (packet[0] & 7) != 3) {
+                ++ignored;
+                udp.flush();
+                return true;
+        }
+        udp.flush();
+
+        fillReply(received);
+        udp.beginPacket(udp.remoteIP(), udp.remotePort());
+
+        auto transmit = ntpNow();
+        ntpWriteStamp(packet + 40, transmit);
+        udp.write(packet, NTP_PACKET);
+        udp.endPacket();
+
+        latencyLast = transmit - received;
+        latencyTotal += latencyLast;
+        if (latencyLast > latencyWorst) latencyWorst = latencyLast;
+        ++requests;
+        ++requestCount;
+        return true;
 }
 
-void NtpService() {
-        if (TimeService::isStale()) {
-                // flash the LED 4 times if our time sync isn't working
-                showActivity(4);
+unsigned long NtpService() {
+        static Instant staleCheck;      ///< When to look at the sync again
+
+        if (reached(staleCheck)) {
+                staleCheck = monoNow() + secs(1);
+                if (TimeService::isStale()) {
+                        // flash the LED 4 times if our time sync isn't working
+                        showActivity(4);
+                }
         }
-}
\ No newline at end of file
+
+        if (reached(rateSecond + secs(1))) {
+                requestRate = requestCount;
+                requestCount = 0;
+                rateSecond = monoNow();
+        }
+
+        // The socket does not survive the link; bind it again on the next one
+        if (WiFi.status() != WL_CONNECTED) {
+                if (listening) udp.stop();
+                listening = false;
+                return msUntil(staleCheck);
+        }
+        if (!listening) listening = udp.begin(NTP_PORT);
+        if (!listening) return msUntil(staleCheck);
+
+        for (int i = 0; i < NTP_BURST && serveRequest(); i++) ;
+
+        // Requests wait in the UDP stack until the next pass
+        return 10;
+}
+
+// Report request counts and reply latency
+void showNtpServerStats()
+{
+        p("\nNTP server: %lu requests, %u/s, %lu ignored\n", requests, requestRate, ignored);
+        if (requests)
+                p("  latency last %luus, mean %luus, worst %luus\n",
+                  latencyLast, latencyTotal / requests, latencyWorst);
+}
+
+void writeNtpServerMetrics(MetricsBuffer & m)
+{
+        m.counter("ntp_server_requests_total", "NTP requests answered", requests);
+        m.counter("ntp_server_ignored_total", "Packets that were not client requests", ignored);
+        m.gauge("ntp_server_request_rate", "NTP requests answered in the last second", requestRate);
+        m.gauge("ntp_server_latency_microseconds", "Receive to transmit time of the last reply", latencyLast);
+        m.gauge("ntp_server_latency_worst_microseconds", "Worst receive to transmit time", latencyWorst);
+}
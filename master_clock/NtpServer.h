@@ -1,2 +1,12 @@
 void NtpSetup() ;
-void NtpService() ;
+
+// Watch the time sync and answer NTP requests.  Returns milliseconds
+// until it wants to be called again.
+unsigned long NtpService() ;
+
+// Report request counts and reply latency on the console
+void showNtpServerStats() ;
+
+// Write request counts and reply latency
+class MetricsBuffer ;
+void writeNtpServerMetrics( MetricsBuffer & m ) ;
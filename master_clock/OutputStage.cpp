@@ -0,0 +1,171 @@
+/*
+    Master Clock - Drives an IBM Impulse Secondary clock movement
+    using the International Business Machine Time Protocols,
+    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+    By Phil Hord,  This code is in the public domain Sept 9, 2013
+*/
+
+//_____________________________________________________________________
+//                                                             INCLUDES
+#include "Arduino.h"
+#include "console.h"
+#include "OutputStage.h"
+#include "SpscRing.h"
+#include "Metrics.h"
+
+//_____________________________________________________________________
+//                                                            CONSTANTS
+
+#define MAX_LINES       32      ///< Lines that fit in the mask
+
+//_____________________________________________________________________
+//                                                           LOCAL VARS
+
+static unsigned lineCount = 0 ;
+
+// Cost of each edge, in CPU cycles
+static unsigned long edgeCount = 0 ;
+static uint32_t lastCycles = 0 , worstCycles = 0 ;
+static uint32_t lastSkew = 0 , worstSkew = 0 ;
+
+//_____________________________________________________________________
+//                                                             BACKENDS
+//
+// Each backend sets up its pins in setupLines() and writes one edge in
+// writeLines(), which returns the cycles between the first and the last
+// line changing.
+
+#if OUTPUT_STAGE == OUTPUT_GPIO
+
+static const char backendName[] = "gpio" ;
+static uint32_t lineMask[MAX_LINES] ;   ///< GPO bit of each line
+static uint32_t allLines = 0 ;          ///< GPO bits of every line
+
+static void setupLines( const int * pins ) {
+  for ( unsigned i = 0 ; i < lineCount ; i++ ) {
+    // GPIO16 lives in another register and can not change with the rest
+    if ( pins[i] > 15 ) {
+      plog( LOG_ERROR , "Pin %d can not be on the GPIO output stage\n" , pins[i] ) ;
+      continue ;
+    }
+    pinMode( pins[i] , OUTPUT ) ;
+    lineMask[i] = 1UL << pins[i] ;
+    allLines |= lineMask[i] ;
+  }
+}
+
+// The loop only touches other pins through the GPOS/GPOC registers,
+// which an interrupt can not split, so this read-modify-write is safe.
+static uint32_t IRAM_ATTR writeLines( unsigned lines ) {
+  uint32_t high = 0 ;
+  for ( int i = 0 ; lines ; i++ , lines >>= 1 )
+    if ( lines & 1 ) high |= lineMask[i] ;
+  GPO = ( GPO & ~allLines ) | high ;
+  return 0 ;
+}
+
+#elif OUTPUT_STAGE == OUTPUT_PINS
+
+static const char backendName[] = "pins" ;
+static int linePin[MAX_LINES] ;
+
+static void setupLines( const int * pins ) {
+  for ( unsigned i = 0 ; i < lineCount ; i++ ) {
+    linePin[i] = pins[i] ;
+    pinMode( pins[i] , OUTPUT ) ;
+  }
+}
+
+static uint32_t IRAM_ATTR writeLines( unsigned lines ) {
+  uint32_t first = ESP.getCycleCount() , last = first ;
+  for ( unsigned i = 0 ; i < lineCount ; i++ ) {
+    last = ESP.getCycleCount() ;
+    digitalWrite( linePin[i] , ( lines >> i ) & 1 ) ;
+  }
+  return last - first ;
+}
+
+#elif OUTPUT_STAGE == OUTPUT_SHIFT
+
+static const char backendName[] = "shift" ;
+static unsigned shiftBits ;             ///< Outputs in the chain
+
+static void setupLines( const int * ) {
+  shiftBits = ( lineCount + 7 ) & ~7u ;
+  pinMode( SHIFT_DATA , OUTPUT ) ;
+  pinMode( SHIFT_CLOCK , OUTPUT ) ;
+  pinMode( SHIFT_LATCH , OUTPUT ) ;
+}
+
+// Shift the whole chain, last output first, then latch every output
+// at once.  The outputs only change at the latch.
+static uint32_t IRAM_ATTR writeLines( unsigned lines ) {
+  for ( int i = shiftBits - 1 ; i >= 0 ; i-- ) {
+    if ( ( lines >> i ) & 1 ) GPOS = 1UL << SHIFT_DATA ;
+    else GPOC = 1UL << SHIFT_DATA ;
+    GPOS = 1UL << SHIFT_CLOCK ;
+    GPOC = 1UL << SHIFT_CLOCK ;
+  }
+  GPOS = 1UL << SHIFT_LATCH ;
+  GPOC = 1UL << SHIFT_LATCH ;
+  return 0 ;
+}
+
+#elif OUTPUT_STAGE == OUTPUT_MOCK
+
+static const char backendName[] = "mock" ;
+static SpscRing<OutputEdge, 64> mockEdges ;
+
+static void setupLines( const int * ) {
+}
+
+static uint32_t IRAM_ATTR writeLines( unsigned lines ) {
+  mockEdges.push( { lines , micros() } ) ;
+  return 0 ;
+}
+
+#else
+#error "Unknown OUTPUT_STAGE"
+#endif
+
+//_____________________________________________________________________
+
+void outputSetup( const int * pins , unsigned count ) {
+  lineCount = count < MAX_LINES ? count : MAX_LINES ;
+  setupLines( pins ) ;
+  outputWrite( 0 ) ;
+}
+
+void IRAM_ATTR outputWrite( unsigned lines ) {
+  uint32_t start = ESP.getCycleCount() ;
+  uint32_t skew = writeLines( lines ) ;
+  uint32_t cycles = ESP.getCycleCount() - start ;
+
+  ++edgeCount ;
+  lastCycles = cycles ;
+  if ( cycles > worstCycles ) worstCycles = cycles ;
+  lastSkew = skew ;
+  if ( skew > worstSkew ) worstSkew = skew ;
+}
+
+bool readOutputEdge( OutputEdge & edge ) {
+#if OUTPUT_STAGE == OUTPUT_MOCK
+  return mockEdges.pop( edge ) ;
+#else
+  (void) edge ;
+  return false ;
+#endif
+}
+
+void showOutputStats() {
+  p( "\nOutput %s: %u lines, %lu edges\n" , backendName , lineCount , edgeCount ) ;
+  p( "  cost %lu cycles, worst %lu; skew %lu cycles, worst %lu\n" ,
+     (unsigned long) lastCycles , (unsigned long) worstCycles ,
+     (unsigned long) lastSkew , (unsigned long) worstSkew ) ;
+}
+
+void writeOutputMetrics( MetricsBuffer & m ) {
+  m.counter( "clock_output_edges_total" , "Edges written to the output stage" , edgeCount ) ;
+  m.gauge( "clock_output_cost_worst_cycles" , "Worst CPU cycles to write one edge" , worstCycles ) ;
+  m.gauge( "clock_output_skew_worst_cycles" , "Worst cycles between the first and last line changing" , worstSkew ) ;
+}
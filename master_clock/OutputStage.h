@@ -0,0 +1,64 @@
+// OutputStage.h
+//
+// Output stage for the signal lines
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// The pulse timer hands every edge to outputWrite() as one mask of
+// lines.  The backend that turns the mask into pin levels is chosen at
+// build time with OUTPUT_STAGE, so the interrupt path has no dispatch:
+//
+//   OUTPUT_GPIO    GPIO0-15 changed together with one GPO register write
+//   OUTPUT_PINS    one digitalWrite per line, for any pin including GPIO16
+//   OUTPUT_SHIFT   a chain of 74HC595 shift registers, changed at the latch
+//   OUTPUT_MOCK    no pins; edges are recorded with their micros() time
+//
+// Every backend counts the CPU cycles each edge takes and the cycles
+// between the first and the last line changing, which is the skew
+// between the lines.  GPIO and shift register edges are a single store,
+// so their skew is zero by construction.
+
+#define OUTPUT_GPIO     0
+#define OUTPUT_PINS     1
+#define OUTPUT_SHIFT    2
+#define OUTPUT_MOCK     3
+
+#ifndef OUTPUT_STAGE
+#define OUTPUT_STAGE    OUTPUT_GPIO
+#endif
+
+// Shift register pins.  Line i drives output i of the chain, counting
+// from QA of the register nearest the ESP.
+#ifndef SHIFT_DATA
+#define SHIFT_DATA      5       // D1
+#define SHIFT_CLOCK     4       // D2
+#define SHIFT_LATCH     15      // D8
+#endif
+
+// Set up `count` lines.  pins[i] is the GPIO pin of line i; the shift
+// register and mock backends do not use it.
+void outputSetup( const int * pins , unsigned count ) ;
+
+// Raise the given lines and lower all the others.  Called from the
+// pulse timer interrupt.
+void outputWrite( unsigned lines ) ;
+
+// One edge recorded by the mock backend
+struct OutputEdge {
+        unsigned lines ;        ///< Lines raised after the edge
+        unsigned long micros ;  ///< micros() when it was written
+} ;
+
+// Fetch the next edge recorded by the mock backend.  Returns false if
+// none, and always with the other backends.
+bool readOutputEdge( OutputEdge & edge ) ;
+
+// Report the backend and its per-edge cost and skew on the console
+void showOutputStats() ;
+
+// Write the edge count, cost and skew
+class MetricsBuffer ;
+void writeOutputMetrics( MetricsBuffer & m ) ;
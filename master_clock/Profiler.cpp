@@ -0,0 +1,82 @@
+/*
+    Master Clock - Drives an IBM Impulse Secondary clock movement
+    using the International Business Machine Time Protocols,
+    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+    By Phil Hord,  This code is in the public domain Sept 9, 2013
+*/
+
+//_____________________________________________________________________
+//                                                             INCLUDES
+#include <string.h>
+#include "Arduino.h"
+#include "console.h"
+#include "Profiler.h"
+
+#ifdef PROFILE_LOOP
+
+//_____________________________________________________________________
+//                                                            CONSTANTS
+
+#define PROFILE_SLOTS     24      // Tasks plus marked blocks
+#define PROFILE_WINDOWS   8       // Seconds of recent worst times kept
+
+//_____________________________________________________________________
+//                                                           LOCAL VARS
+
+struct ProfileSlot {
+  const char * name ;
+  unsigned long calls ;
+  uint64_t total ;                      ///< Cycles, summed
+  uint32_t worst ;                      ///< Longest call since boot
+  uint32_t recent[PROFILE_WINDOWS] ;    ///< Longest call in each second
+} ;
+
+static ProfileSlot slots[PROFILE_SLOTS] ;
+static int nSlots = 0 ;
+static int window = 0 ;                 ///< recent[] entry filling now
+
+//_____________________________________
+// Slots are only looked up once per call site, so a linear search is fine
+int profileSlot( const char * name ) {
+  for ( int i = 0 ; i < nSlots ; i++ )
+    if ( !strcmp( slots[i].name , name ) ) return i ;
+  if ( nSlots >= PROFILE_SLOTS ) return PROFILE_SLOTS - 1 ;
+  slots[nSlots].name = name ;
+  return nSlots++ ;
+}
+
+void profileEnd( int slot , uint32_t start ) {
+  uint32_t cycles = ESP.getCycleCount() - start ;
+  auto & s = slots[slot] ;
+  ++s.calls ;
+  s.total += cycles ;
+  if ( cycles > s.worst ) s.worst = cycles ;
+  if ( cycles > s.recent[window] ) s.recent[window] = cycles ;
+}
+
+void profileTick() {
+  window = ( window + 1 ) % PROFILE_WINDOWS ;
+  for ( int i = 0 ; i < nSlots ; i++ ) slots[i].recent[window] = 0 ;
+}
+
+void showProfile() {
+  unsigned mhz = ESP.getCpuFreqMHz() ;
+  p( "\nProfile: calls, total ms, mean/worst/recent worst us\n" ) ;
+  for ( int i = 0 ; i < nSlots ; i++ ) {
+    auto & s = slots[i] ;
+    uint32_t recent = 0 ;
+    for ( auto r : s.recent ) if ( r > recent ) recent = r ;
+    unsigned long mean = s.calls ? s.total / s.calls / mhz : 0 ;
+    p( "%s: %lu, %lu, %lu/%lu/%lu\n" , s.name , s.calls ,
+       (unsigned long) ( s.total / mhz / 1000 ) , mean ,
+       (unsigned long) ( s.worst / mhz ) , (unsigned long) ( recent / mhz ) ) ;
+  }
+}
+
+#else
+
+void showProfile() {
+  p( "\nProfiler not built in; build with -DPROFILE_LOOP\n" ) ;
+}
+
+#endif
@@ -0,0 +1,63 @@
+// Profiler.h
+//
+// Cycle-counter timing of each task and subsystem
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Every scheduler task is timed, along with the time the core and WiFi
+// stack take between passes, and any block marked with PROFILE().  Each
+// gets a call count, total and worst time, and the worst of the last
+// few seconds, so a late edge can be matched to what held up the loop.
+//
+// Build with -DPROFILE_LOOP to turn it on.  Without it PROFILE() and
+// ProfileScope compile to nothing.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "Arduino.h"
+
+#ifdef PROFILE_LOOP
+
+// Find or add the profile slot for a name.  The string must stay put.
+int profileSlot( const char * name ) ;
+
+// Charge the cycles since `start` to a slot
+void profileEnd( int slot , uint32_t start ) ;
+
+// Start a new recent-max window.  The scheduler calls it every second.
+void profileTick() ;
+
+// Times the enclosing scope
+struct ProfileScope {
+  int slot ;
+  uint32_t start ;
+  ProfileScope( int slot ) : slot( slot ) , start( ESP.getCycleCount() ) {}
+  ~ProfileScope() { profileEnd( slot , start ) ; }
+} ;
+
+#define PROFILE_JOIN2( a , b ) a##b
+#define PROFILE_JOIN( a , b ) PROFILE_JOIN2( a , b )
+
+// Time the rest of the enclosing block under `name`
+#define PROFILE( name ) \
+  static const int PROFILE_JOIN( profileSlot_ , __LINE__ ) = profileSlot( name ) ; \
+  ProfileScope PROFILE_JOIN( profileScope_ , __LINE__ )( PROFILE_JOIN( profileSlot_ , __LINE__ ) )
+
+#else
+
+inline int profileSlot( const char * ) { return 0 ; }
+inline void profileEnd( int , uint32_t ) {}
+inline void profileTick() {}
+struct ProfileScope { ProfileScope( int ) {} } ;
+#define PROFILE( name ) do {} while ( 0 )
+
+#endif
+
+// Report every slot on the console
+void showProfile() ;
+
+#endif
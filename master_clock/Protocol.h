@@ -0,0 +1,303 @@
+// Protocol.h
+//
+// Master/slave clock protocols as compile-time policies
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// A protocol says which lines pulse in each second of the hour, how long
+// a pulse is, and how the movement on the lines steps its minute hand.
+// Each one is a policy struct; ProtocolEngine<> builds its schedule and
+// face model from it with constexpr, and the build picks one with
+// CLOCK_PROTOCOL, the same way as OUTPUT_STAGE.  Everything is resolved
+// at compile time, so the per-second path has no dispatch to pay for.
+//
+// A policy supplies:
+//
+//   lines              SIGNAL_* bits the protocol drives
+//   riseMs, fallMs     Pulse timing, filling one second
+//   signals(s, m)      Lines raised at second s of minute m of the hour
+//   steppingLine(f)    Lines that step a face showing minute f
+//   blocking(f)        Lines that keep that face still when raised with them
+//   catchUp(f)         Lines for a catch-up pulse at face f
+//   run(f)             Lines raised while the RUN switch is held
+//   waiting(f, m)      Lines a waiting face may still be sent in minute m,
+//                      without stepping it, for other movements on the line
+//   riding(f)          Lines added to a schedule pulse that steps a slow
+//                      face f, for movements the schedule can't correct
+//
+// PulseSchedule.cpp checks every protocol exhaustively at compile time.
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+#include "clock_generic.h"
+#include "PulseSchedule.h"
+
+#define PROTOCOL_IBM            1   // IBM A/B/D minute impulse with hourly correction
+#define PROTOCOL_MINUTE         2   // Plain minute impulse on D, no correction
+#define PROTOCOL_POLARIZED      3   // Minute impulse alternating between A and B
+
+#ifndef CLOCK_PROTOCOL
+#define CLOCK_PROTOCOL PROTOCOL_IBM
+#endif
+
+//_____________________________________________________________________
+//                                                            PROTOCOLS
+
+// IBM Time Protocol.  The movement's cam decides which line can step
+// the minute hand:
+//
+//   face :59 and :00-:48   steps on a B pulse
+//   face :49-:58           steps on an A pulse
+//
+// With the normal schedule a correct clock steps every minute.  A fast
+// clock parks at :59, because B is silent during minutes 50-59, and
+// leaves it with the B pulse at the top of the hour.  A slow clock whose
+// face is in :49-:58 during minute 59 is stepped up to :59 by the A
+// correction burst.  D drives plain minute-impulse movements, which step
+// on every D pulse and have no correction.
+struct IbmProtocol {
+        static constexpr const char name[] = "IBM" ;
+        static constexpr unsigned lines = SIGNAL_A | SIGNAL_B | SIGNAL_D ;
+        static constexpr unsigned riseMs = 600 , fallMs = 400 ;
+
+        // A once per minute at zero-seconds, and on every even second
+        // between 10 and 50 during the 59th minute.  B once per minute
+        // except for minutes 50 to 59.  D once per minute.
+        static constexpr unsigned signals( unsigned s , unsigned m ) {
+                return ( s == 0 || ( m == 59 && s >= 10 && s <= 50 && ( s & 1 ) == 0 ) ? SIGNAL_A : 0 )
+                     | ( s == 0 && m <= 49 ? SIGNAL_B : 0 )
+                     | ( s == 0 ? SIGNAL_D : 0 ) ;
+        }
+
+        static constexpr unsigned steppingLine( unsigned face ) {
+                return ( face % 60 >= 49 && face % 60 <= 58 ) ? SIGNAL_A : SIGNAL_B ;
+        }
+        static constexpr unsigned blocking( unsigned ) { return 0 ; }
+
+        // Catch-up pulses raise A, B and D together, as the original
+        // controller did.  The cam passes only one of A and B to the
+        // minute hand, so each pulse steps any face exactly once, and D
+        // keeps plain movements on the same lines up.
+        static constexpr unsigned catchUp( unsigned ) { return lines ; }
+
+        static constexpr unsigned run( unsigned ) { return lines ; }
+
+        // A face parked at :59 late in the hour ignores A and gets no B
+        // until the top of the hour, so the A/B schedule can go on for
+        // any other movements on the line.
+        static constexpr unsigned waiting( unsigned face , unsigned m ) {
+                return ( face % 60 == 59 && m >= 50 ) ? SIGNAL_A | SIGNAL_B : 0 ;
+        }
+
+        // A slow face in :49-:58 late in the hour is left to the minute
+        // 59 A burst, which steps no face already at :59.  Plain
+        // movements have no correction, so D goes with each pulse that
+        // steps it.
+        static constexpr unsigned riding( unsigned ) { return SIGNAL_D ; }
+} ;
+
+// Plain minute impulse: every movement steps on each D pulse.  A fast
+// clock can only be stopped, so every line goes quiet while it waits.
+struct MinuteProtocol {
+        static constexpr const char name[] = "minute" ;
+        static constexpr unsigned lines = SIGNAL_D ;
+        static constexpr unsigned riseMs = 600 , fallMs = 400 ;
+
+        static constexpr unsigned signals( unsigned s , unsigned ) {
+                return s == 0 ? SIGNAL_D : 0 ;
+        }
+        static constexpr unsigned steppingLine( unsigned ) { return SIGNAL_D ; }
+        static constexpr unsigned blocking( unsigned ) { return 0 ; }
+        static constexpr unsigned catchUp( unsigned ) { return SIGNAL_D ; }
+        static constexpr unsigned run( unsigned ) { return SIGNAL_D ; }
+        static constexpr unsigned waiting( unsigned , unsigned ) { return 0 ; }
+        static constexpr unsigned riding( unsigned ) { return 0 ; }
+} ;
+
+// Polarized minute impulse.  The line pair is driven with alternate
+// polarity each minute: A for even minutes, B for odd ones.  The
+// movement's armature only steps on the polarity opposite to its last
+// step, so a face that misses a pulse also ignores the next one, and
+// runs on two minutes slow until catch-up pulses bring it back.  With
+// both lines raised there is no current through the coil, so every
+// pulse must carry exactly one polarity.
+struct PolarizedProtocol {
+        static constexpr const char name[] = "polarized" ;
+        static constexpr unsigned lines = SIGNAL_A | SIGNAL_B ;
+        static constexpr unsigned riseMs = 500 , fallMs = 500 ;
+
+        static constexpr unsigned polarity( unsigned minute ) {
+                return ( minute & 1 ) ? SIGNAL_B : SIGNAL_A ;
+        }
+        static constexpr unsigned signals( unsigned s , unsigned m ) {
+                return s == 0 ? polarity( m ) : 0 ;
+        }
+        static constexpr unsigned steppingLine( unsigned face ) { return polarity( face + 1 ) ; }
+        static constexpr unsigned blocking( unsigned face ) { return polarity( face ) ; }
+        static constexpr unsigned catchUp( unsigned face ) { return polarity( face + 1 ) ; }
+        static constexpr unsigned run( unsigned face ) { return polarity( face + 1 ) ; }
+        static constexpr unsigned waiting( unsigned , unsigned ) { return 0 ; }
+        static constexpr unsigned riding( unsigned ) { return 0 ; }
+} ;
+
+//_____________________________________________________________________
+//                                                               ENGINE
+
+template < class P >
+struct ProtocolEngine {
+        typedef P Policy ;
+
+        static constexpr unsigned HOUR_TIME = 60 * 60 ;
+        static constexpr unsigned WORDS = ( HOUR_TIME + 31 ) / 32 ;
+        static constexpr unsigned FACES = MAX_TIME / 60 ;
+
+        // The schedule repeats every hour; one bit per second per line
+        struct Schedule {
+                uint32_t bits[LINES_PER_CHANNEL][WORDS] ;
+        } ;
+
+        static constexpr Schedule buildSchedule() {
+                Schedule sched = {} ;
+                for ( unsigned t = 0 ; t < HOUR_TIME ; t++ ) {
+                        unsigned raised = P::signals( t % 60 , t / 60 ) ;
+                        for ( unsigned l = 0 ; l < LINES_PER_CHANNEL ; l++ )
+                                if ( raised & ( 1u << l ) )
+                                        sched.bits[l][t / 32] |= uint32_t( 1 ) << ( t % 32 ) ;
+                }
+                return sched ;
+        }
+
+        // Lines raised at second t of the 12-hour dial
+        static constexpr unsigned signals( unsigned t ) {
+                return P::signals( t % 60 , t / 60 % 60 ) ;
+        }
+
+        // Face position after the movement sees a pulse on these lines
+        static constexpr unsigned stepFace( unsigned face , unsigned raised ) {
+                return ( raised & P::steppingLine( face ) ) && !( raised & P::blocking( face ) )
+                        ? ( face + 1 ) % FACES : face ;
+        }
+
+        // Lines of each pulse of an n-pulse catch-up burst from `face`,
+        // into slots[0] to slots[n-1].  Each pulse is decided for the
+        // face the ones before it leave, so a polarized burst alternates.
+        // Returns the face after the burst.
+        static constexpr unsigned catchUpBurst( unsigned face , unsigned n , unsigned * slots ) {
+                for ( unsigned i = 0 ; i < n ; i++ ) {
+                        slots[i] = P::catchUp( face ) ;
+                        face = stepFace( face , slots[i] ) ;
+                }
+                return face ;
+        }
+
+        // Of the lines due at second t, the ones a waiting face may be sent
+        static constexpr unsigned waitSignals( unsigned face , unsigned t , unsigned raised ) {
+                return raised & P::waiting( face , t / 60 % 60 ) ;
+        }
+
+        // Seconds the schedule alone takes from second t to bring a slow
+        // face right, if it does so within the minute; 0 if it doesn't
+        static constexpr unsigned scheduleCatchUp( unsigned face , unsigned t ) {
+                for ( unsigned u = t ; u < t / 60 * 60 + 60 ; u++ ) {
+                        face = stepFace( face , signals( u ) ) ;
+                        if ( face == u / 60 ) return u - t + 1 ;
+                }
+                return 0 ;
+        }
+
+        // Lines to send a face riding the schedule's correction, of the
+        // `raised` ones due
+        static constexpr unsigned rideSignals( unsigned face , unsigned raised ) {
+                return stepFace( face , raised ) != face ? raised | P::riding( face ) : raised ;
+        }
+
+        //_____________________________________
+        // Checks, for static_assert
+
+        // Only the protocol's own lines are ever raised
+        static constexpr bool staysOnLines() {
+                for ( unsigned t = 0 ; t < HOUR_TIME ; t++ )
+                        if ( P::signals( t % 60 , t / 60 ) & ~P::lines ) return false ;
+                for ( unsigned f = 0 ; f < FACES ; f++ )
+                        if ( ( P::catchUp( f ) | P::run( f ) | P::riding( f ) ) & ~P::lines ) return false ;
+                return true ;
+        }
+
+        // A face that starts right follows the schedule all the way round
+        static constexpr bool tracksRealTime() {
+                unsigned face = FACES - 1 ;
+                for ( unsigned t = 0 ; t < MAX_TIME ; t++ ) {
+                        face = stepFace( face , signals( t ) ) ;
+                        if ( face != t / 60 ) return false ;
+                }
+                return true ;
+        }
+
+        // Every catch-up pulse steps the face exactly one minute
+        static constexpr bool catchUpSteps() {
+                for ( unsigned f = 0 ; f < FACES ; f++ )
+                        if ( stepFace( f , P::catchUp( f ) ) != ( f + 1 ) % FACES ) return false ;
+                return true ;
+        }
+
+        // A burst of n pulses, up to LONGEST, gains n minutes from any
+        // face.  A pulse raising the lines of two different steps, like
+        // both polarities at once, gains nothing and fails this.
+        template < unsigned LONGEST >
+        static constexpr bool burstsStep() {
+                for ( unsigned n = 2 ; n <= LONGEST ; n++ )
+                        for ( unsigned f = 0 ; f < FACES ; f++ ) {
+                                unsigned slots[LONGEST] = {} ;
+                                if ( catchUpBurst( f , n , slots ) != ( f + n ) % FACES ) return false ;
+                        }
+                return true ;
+        }
+
+        // Holding RUN steps the face every second, all the way round the
+        // dial, when each second's lines are decided for the face the
+        // second before left, as markTime() does
+        static constexpr bool runSteps() {
+                unsigned face = 0 ;
+                for ( unsigned t = 1 ; t <= FACES ; t++ ) {
+                        face = stepFace( face , P::run( face ) ) ;
+                        if ( face != t % FACES ) return false ;
+                }
+                return true ;
+        }
+
+        // The lines added for a riding face don't step it any further
+        static constexpr bool ridingHolds() {
+                for ( unsigned f = 0 ; f < 60 ; f++ )
+                        for ( unsigned t = 0 ; t < HOUR_TIME ; t++ )
+                                if ( stepFace( f , rideSignals( f , signals( t ) ) ) != stepFace( f , signals( t ) ) )
+                                        return false ;
+                return true ;
+        }
+
+        // No pulse sent to a waiting face moves it.  The protocols only
+        // look at the face's minute in the hour, so one hour of faces
+        // against one hour of schedule covers every case.
+        static constexpr bool waitingHolds() {
+                for ( unsigned f = 0 ; f < 60 ; f++ )
+                        for ( unsigned t = 0 ; t < HOUR_TIME ; t++ )
+                                if ( stepFace( f , waitSignals( f , t , signals( t ) ) ) != f ) return false ;
+                return true ;
+        }
+} ;
+
+#if CLOCK_PROTOCOL == PROTOCOL_IBM
+typedef ProtocolEngine< IbmProtocol > ClockProtocol ;
+#elif CLOCK_PROTOCOL == PROTOCOL_MINUTE
+typedef ProtocolEngine< MinuteProtocol > ClockProtocol ;
+#elif CLOCK_PROTOCOL == PROTOCOL_POLARIZED
+typedef ProtocolEngine< PolarizedProtocol > ClockProtocol ;
+#else
+#error "Unknown CLOCK_PROTOCOL"
+#endif
+
+#endif
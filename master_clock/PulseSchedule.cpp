@@ -0,0 +1,128 @@
+/*
+    Master Clock - Drives an IBM Impulse Secondary clock movement
+    using the International Business Machine Time Protocols,
+    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+    By Phil Hord,  This code is in the public domain Sept 9, 2013
+*/
+
+//_____________________________________________________________________
+//                                                             INCLUDES
+#include "Arduino.h"
+#include "clock_generic.h"
+#include "PulseSchedule.h"
+#include "PulseTimer.h"
+
+#include "Protocol.h"
+
+//_____________________________________________________________________
+//                                                            CONSTANTS
+
+// The schedule repeats every hour; one bit per second per signal
+static constexpr unsigned HOUR_TIME = ClockProtocol::HOUR_TIME ;
+static constexpr unsigned SCHEDULE_WORDS = ClockProtocol::WORDS ;
+
+//_____________________________________________________________________
+//                                                      PROTOCOL CHECKS
+//
+// Every protocol is checked here whichever one the build uses, by
+// running its face model over the whole dial in the compiler.
+
+template < class P >
+static constexpr bool protocolChecks() {
+        typedef ProtocolEngine< P > E ;
+        static_assert( P::riseMs + P::fallMs == 1000 , "pulse must fill one second" ) ;
+        static_assert( E::staysOnLines() , "protocol raises a line it does not own" ) ;
+        static_assert( E::tracksRealTime() , "a correct face must follow the schedule" ) ;
+        static_assert( E::catchUpSteps() , "a catch-up pulse must step the face" ) ;
+        static_assert( E::template burstsStep< MAX_BURST >() , "each pulse of a burst must step the face" ) ;
+        static_assert( E::runSteps() , "each second of RUN must step the face" ) ;
+        static_assert( E::waitingHolds() , "a waiting face must not step" ) ;
+        static_assert( E::ridingHolds() , "riding lines must not step the face" ) ;
+        return true ;
+}
+
+static_assert( protocolChecks< IbmProtocol >() , "" ) ;
+static_assert( protocolChecks< MinuteProtocol >() , "" ) ;
+static_assert( protocolChecks< PolarizedProtocol >() , "" ) ;
+
+// Face after the movement follows the schedule from second `from` of the
+// hour through the top of the next hour
+template < class P >
+static constexpr unsigned runToHour( unsigned face , unsigned from ) {
+        typedef ProtocolEngine< P > E ;
+        for ( unsigned t = from ; t <= E::HOUR_TIME ; t++ )
+                face = E::stepFace( face , E::signals( t ) ) ;
+        return face ;
+}
+
+// The IBM hourly correction: any face in :49-:58 at minute 59, up to
+// nine minutes slow, or from right to ten minutes fast at minute 50,
+// shows the hour after its top-of-the-hour pulse.
+static constexpr bool ibmCorrects() {
+        for ( unsigned face = 49 ; face <= 58 ; face++ )
+                if ( runToHour< IbmProtocol >( face , 59 * 60 ) != 60 ) return false ;
+        for ( unsigned face = 49 ; face <= 59 ; face++ )
+                if ( runToHour< IbmProtocol >( face , 50 * 60 ) != 60 ) return false ;
+        return true ;
+}
+static_assert( ibmCorrects() , "IBM hourly correction must fix the face" ) ;
+
+// A plain minute movement that is behind stays behind
+static_assert( runToHour< MinuteProtocol >( 48 , 59 * 60 ) == 50 , "minute impulse has no correction" ) ;
+
+// A polarized movement that missed a pulse also ignores the next one
+static_assert( runToHour< PolarizedProtocol >( 57 , 59 * 60 ) == 58 , "polarized face out of step must skip" ) ;
+
+static const ClockProtocol::Schedule schedule PROGMEM = ClockProtocol::buildSchedule() ;
+
+//_____________________________________
+// Read one 32-second word of the schedule, merged for the signals in mask
+static inline uint32_t scheduleWord(unsigned w, unsigned mask) {
+        uint32_t bits = 0;
+        if (mask & SIGNAL_A) bits |= pgm_read_dword(&schedule.bits[0][w]);
+        if (mask & SIGNAL_B) bits |= pgm_read_dword(&schedule.bits[1][w]);
+        if (mask & SIGNAL_D) bits |= pgm_read_dword(&schedule.bits[2][w]);
+        return bits;
+}
+
+//_____________________________________
+// Bitmask of the signals raised at second t
+unsigned pulseSignals(unsigned t) {
+        t %= HOUR_TIME;
+        unsigned w = t / 32;
+        uint32_t bit = uint32_t(1) << (t % 32);
+
+        unsigned signals = 0;
+        if (pgm_read_dword(&schedule.bits[0][w]) & bit) signals |= SIGNAL_A;
+        if (pgm_read_dword(&schedule.bits[1][w]) & bit) signals |= SIGNAL_B;
+        if (pgm_read_dword(&schedule.bits[2][w]) & bit) signals |= SIGNAL_D;
+        return signals;
+}
+
+//_____________________________________
+// Count seconds before the next pulse on any signal in mask.
+//
+// Scans the schedule a word at a time.  Most lines pulse every minute,
+// so a search touches at most three words; IBM's B alone can wait out
+// minutes 50-59, which is still only a couple dozen words.
+unsigned secondsUntilNextPulse(unsigned t, unsigned mask) {
+        mask &= ClockProtocol::Policy::lines;
+        if (!mask) return MAX_TIME;
+
+        t %= HOUR_TIME;
+        unsigned w = t / 32;
+        unsigned skip = t % 32;
+        uint32_t bits = scheduleWord(w, mask) >> skip;
+        unsigned waited = 0;
+
+        // Every signal pulses at least once per hour, so this terminates
+        while (!bits) {
+                // The last word only holds the final HOUR_TIME % 32 seconds
+                unsigned len = (w == SCHEDULE_WORDS - 1) ? HOUR_TIME - w * 32 : 32;
+                waited += len - skip;
+                skip = 0;
+                w = (w + 1) % SCHEDULE_WORDS;
+                bits = scheduleWord(w, mask);
+        }
+        return waited + __builtin_ctz(bits);
+}
@@ -0,0 +1,32 @@
+// PulseSchedule.h
+//
+// Precomputed A/B/D pulse schedule of the build's protocol
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Every protocol repeats every hour, so the whole 12-hour (MAX_TIME)
+// schedule is one hour of packed bits built at compile time from the
+// protocol policy in Protocol.h.  Every lookup is a shift and a mask.
+
+#ifndef PULSE_SCHEDULE_H
+#define PULSE_SCHEDULE_H
+
+// Signal bits returned by pulseSignals()
+enum {
+        SIGNAL_A = 1 ,
+        SIGNAL_B = 2 ,
+        SIGNAL_D = 4 ,
+        SIGNAL_ALL = SIGNAL_A | SIGNAL_B | SIGNAL_D ,
+} ;
+
+// Bitmask of the signals raised at second t (0 <= t < MAX_TIME)
+unsigned pulseSignals(unsigned t) ;
+
+// Seconds from t until the next second that raises any signal in mask.
+// Returns 0 if t itself raises one.
+unsigned secondsUntilNextPulse(unsigned t, unsigned mask = SIGNAL_ALL) ;
+
+#endif
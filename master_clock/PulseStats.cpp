@@ -0,0 +1,85 @@
+/*
+    Master Clock - Drives an IBM Impulse Secondary clock movement
+    using the International Business Machine Time Protocols,
+    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+    By Phil Hord,  This code is in the public domain Sept 9, 2013
+*/
+
+//_____________________________________________________________________
+//                                                             INCLUDES
+#include "Arduino.h"
+#include "console.h"
+#include "PulseTimer.h"
+#include "PulseStats.h"
+
+//_____________________________________________________________________
+//                                                            CONSTANTS
+
+// Bucket 0 holds 0-1us, bucket n holds [2^n, 2^(n+1)) us, and the last
+// bucket holds everything from about 8 seconds up.
+#define BUCKETS         24
+
+//_____________________________________________________________________
+//                                                           LOCAL VARS
+
+struct Histogram {
+        unsigned count[BUCKETS] ;
+        unsigned long worst ;   ///< Largest value seen since boot, in us
+        unsigned total ;
+} ;
+
+static Histogram lateness ;     ///< Rising edge behind the second boundary
+static Histogram widthError ;   ///< Pulse width away from the nominal width
+static unsigned early = 0 ;     ///< Rising edges ahead of the second boundary
+
+static unsigned long riseAt = 0 ;       ///< micros() of the last rising edge
+static unsigned long riseDue = 0 ;      ///< When it should have risen
+static bool haveRise = false ;
+
+//_____________________________________
+// Add one sample in microseconds
+static void add( Histogram & h , unsigned long us ) {
+  int bucket = 0 ;
+  while ( bucket < BUCKETS - 1 && ( us >> (bucket + 1) ) ) ++bucket ;
+
+  ++h.count[bucket] ;
+  ++h.total ;
+  if ( us > h.worst ) h.worst = us ;
+}
+
+void recordPulseEdge( const PulseEdge & edge ) {
+  if ( edge.lines ) {
+    long late = (long) (edge.micros - edge.due) ;
+    if ( late < 0 ) { ++early ; late = 0 ; }
+    add( lateness , late ) ;
+
+    riseAt = edge.micros ;
+    riseDue = edge.due ;
+    haveRise = true ;
+    return ;
+  }
+
+  // Falling edge: measure the width of the pulse it ends
+  if ( !haveRise ) return ;
+  haveRise = false ;
+
+  long error = (long) (edge.micros - riseAt) - (long) (edge.due - riseDue) ;
+  add( widthError , error < 0 ? -error : error ) ;
+}
+
+//_____________________________________
+// Print the non-empty buckets of one histogram
+static void show( const char * name , const Histogram & h ) {
+  p( "%s: %u edges, worst %luus\n" , name , h.total , h.worst ) ;
+  for ( int i = 0 ; i < BUCKETS ; i++ ) {
+    if ( !h.count[i] ) continue ;
+    p( "  <%8luus %u\n" , 2UL << i , h.count[i] ) ;
+  }
+}
+
+void showPulseStats() {
+  p( "\n" ) ;
+  show( "Rise lateness" , lateness ) ;
+  if ( early ) p( "  early    %u\n" , early ) ;
+  show( "Width error" , widthError ) ;
+}
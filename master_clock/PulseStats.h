@@ -0,0 +1,20 @@
+// PulseStats.h
+//
+// Pulse edge timing statistics
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Keeps log2-bucketed histograms of how late each rising edge was
+// against the true second boundary, and how far each pulse width
+// strayed from the width it was queued with.  Memory use is fixed.
+
+struct PulseEdge ;
+
+// Record an edge reported by the pulse timer
+void recordPulseEdge( const PulseEdge & edge ) ;
+
+// Dump the histograms and worst cases to the console
+void showPulseStats() ;
@@ -0,0 +1,205 @@
+/*
+    Master Clock - Drives an IBM Impulse Secondary clock movement
+    using the International Business Machine Time Protocols,
+    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+    By Phil Hord,  This code is in the public domain Sept 9, 2013
+*/
+
+//_____________________________________________________________________
+//                                                             INCLUDES
+#include "Arduino.h"
+#include "clock_generic.h"
+#include "PulseTimer.h"
+#include "SpscRing.h"
+
+//_____________________________________________________________________
+//                                                            CONSTANTS
+
+// timer1 runs at 80MHz/16 = 5 ticks per microsecond.  Its 23-bit counter
+// limits a single wait to about 1.6 seconds.
+#define TICKS_PER_US    5
+#define MAX_WAIT_US     (((1UL << 23) - 1) / TICKS_PER_US)
+
+// Shortest wait we hand to the timer; anything sooner fires right away
+#define MIN_WAIT_US     10
+
+//_____________________________________________________________________
+//                                                           LOCAL VARS
+
+static SpscRing<PulseEdge, 64> edges ;  ///< Edges reported to the loop
+
+// The queued pulse.  Written by the loop only while 'queued' is false.
+static volatile bool queued = false ;
+static unsigned queuedTicket = 0 ;
+static unsigned lastTicket = 0 ;        ///< Ticket of the newest queued pulse
+static unsigned queuedLines[MAX_BURST] ;
+static unsigned long queuedRiseAt ;
+static unsigned long queuedWidth ;
+static unsigned queuedCount ;
+static unsigned long queuedPeriod ;
+
+// True from the moment a pulse is started on the timer until it falls
+static volatile bool busy = false ;
+static volatile bool high = false ;     ///< Lines are raised, waiting to fall
+static unsigned long fallDue ;          ///< When the raised lines should drop
+
+// The rest of the burst being sent
+static unsigned burstLeft = 0 ;         ///< Pulses still to send
+static unsigned burstCount ;            ///< Pulses in the whole burst
+static unsigned burstLines[MAX_BURST] ;
+static unsigned burstTicket = 0 ;       ///< Ticket of the burst being sent
+static unsigned long riseMicros ;       ///< micros() of the last rising edge
+
+// Held for a power failure, and where the hold caught the burst
+static volatile bool held = false ;
+static unsigned heldTicket = 0 ;
+static unsigned heldDelivered = 0 ;
+static unsigned long burstRiseAt ;      ///< When the next one rises
+static unsigned long burstWidth ;
+static unsigned long burstPeriod ;
+
+//_____________________________________
+// Start the timer for an edge that is due at micros() == when
+static void IRAM_ATTR armTimer( unsigned long when ) {
+  long wait = (long) (when - micros()) ;
+  if ( wait < MIN_WAIT_US ) wait = MIN_WAIT_US ;
+  if ( wait > (long) MAX_WAIT_US ) wait = MAX_WAIT_US ;
+  timer1_write( wait * TICKS_PER_US ) ;
+}
+
+//_____________________________________
+// Raise the lines now and set the timer to drop them
+static void IRAM_ATTR rise( unsigned lines , unsigned long due , unsigned long width ) {
+  fallDue = due + width ;
+  sendLines( lines ) ;
+  high = true ;
+  riseMicros = micros() ;
+  edges.push( { lines , riseMicros , due } ) ;
+  timer1_write( width * TICKS_PER_US ) ;
+}
+
+//_____________________________________
+// Timer interrupt: write the next edge and schedule the one after it
+static void IRAM_ATTR pulseTimerIsr() {
+  if ( held ) { busy = false ; return ; }
+
+  if ( high ) {
+    sendLines( 0 ) ;                    // End output pulses
+    high = false ;
+    edges.push( { 0 , micros() , fallDue } ) ;
+
+    if ( burstLeft ) armTimer( burstRiseAt ) ;
+    else if ( queued ) armTimer( queuedRiseAt ) ;
+    else busy = false ;
+    return ;
+  }
+
+  unsigned long due = burstLeft ? burstRiseAt : queuedRiseAt ;
+  if ( !burstLeft && !queued ) { busy = false ; return ; }
+
+  // A wait longer than the timer can count arrives here early; go again
+  if ( (long) (due - micros()) > MIN_WAIT_US ) {
+    armTimer( due ) ;
+    return ;
+  }
+
+  // Take the burst over, so the queue is free for the next second
+  if ( !burstLeft ) {
+    for ( unsigned i = 0 ; i < queuedCount ; i++ ) burstLines[i] = queuedLines[i] ;
+    burstWidth = queuedWidth ;
+    burstPeriod = queuedPeriod ;
+    burstCount = burstLeft = queuedCount ;
+    burstTicket = queuedTicket ;
+    queued = false ;
+  }
+
+  unsigned lines = burstLines[burstCount - burstLeft] ;
+  --burstLeft ;
+  burstRiseAt = due + burstPeriod ;
+  rise( lines , due , burstWidth ) ;
+}
+
+void pulseTimerSetup() {
+  timer1_attachInterrupt( pulseTimerIsr ) ;
+  timer1_enable( TIM_DIV16 , TIM_EDGE , TIM_SINGLE ) ;
+}
+
+unsigned queuePulse( const unsigned * lines , unsigned long riseAt , unsigned long widthUs ,
+                     unsigned count , unsigned long periodUs ) {
+  if ( queued || held || !count || count > MAX_BURST ) return 0 ;
+
+  for ( unsigned i = 0 ; i < count ; i++ ) queuedLines[i] = lines[i] ;
+  queuedRiseAt = riseAt ;
+  queuedWidth = widthUs ;
+  queuedCount = count ;
+  queuedPeriod = periodUs ;
+
+  noInterrupts() ;
+  if ( held ) {
+    interrupts() ;
+    return 0 ;
+  }
+  queuedTicket = ++lastTicket ;
+  if ( !queuedTicket ) queuedTicket = ++lastTicket ;    // 0 means not queued
+  queued = true ;
+  if ( !busy ) {
+    busy = true ;
+    armTimer( riseAt ) ;
+  }
+  interrupts() ;
+  return queuedTicket ;
+}
+
+bool pulsePending() {
+  return queued ;
+}
+
+bool pulseBusy() {
+  return busy ;
+}
+
+bool pulseHigh() {
+  return high ;
+}
+
+bool readPulseEdge( PulseEdge & edge ) {
+  return edges.pop( edge ) ;
+}
+
+unsigned pulseEdgeDrops() {
+  return edges.drops() ;
+}
+
+void IRAM_ATTR pulseHold() {
+  noInterrupts() ;
+  if ( !held ) {
+    // Pulses that rose count, except one cut off before it could step
+    unsigned delivered = burstCount - burstLeft ;
+    if ( high && delivered && (unsigned long) ( micros() - riseMicros ) < MIN_STEP_US ) --delivered ;
+    heldTicket = burstTicket ;
+    heldDelivered = delivered ;
+
+    sendLines( 0 ) ;
+    if ( high ) edges.push( { 0 , micros() , fallDue } ) ;
+    held = true ;
+    high = false ;
+    queued = false ;
+    burstLeft = 0 ;
+  }
+  interrupts() ;
+}
+
+void pulseRelease() {
+  held = false ;
+}
+
+bool pulseHeld() {
+  return held ;
+}
+
+void pulseHoldProgress( unsigned & ticket , unsigned & delivered ) {
+  noInterrupts() ;
+  ticket = heldTicket ;
+  delivered = heldDelivered ;
+  interrupts() ;
+}
@@ -0,0 +1,67 @@
+// PulseTimer.h
+//
+// Hardware-timed pulse edges
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// The main loop decides which lines to raise one second ahead and
+// queues the pulse here.  A line is one signal of one channel, as laid
+// out by CHANNEL_LINES(), so every channel's edge goes out in one
+// write.  The rising and falling edges are then driven from the timer1
+// interrupt, so a slow telnet write or a WiFi scan can not stretch a
+// pulse or delay the edge at the top of the second.  Every edge is
+// reported back to the loop through a lock-free ring.
+
+// One edge emitted by the pulse timer
+struct PulseEdge {
+        unsigned lines ;        ///< CHANNEL_LINES() bits raised; 0 for the falling edge
+        unsigned long micros ;  ///< micros() when the lines were written
+        unsigned long due ;     ///< micros() when the edge should have happened
+} ;
+
+void pulseTimerSetup() ;
+
+// Longest burst the timer can hold
+#define MAX_BURST 16
+
+// Queue a pulse that rises when micros() reaches riseAt and falls
+// widthUs later.  With a count, send that many pulses periodUs apart;
+// lines[i] holds the lines raised by pulse i.  Only one pulse or burst
+// can wait in the queue.  Returns a ticket that numbers the queued
+// pulses, or 0 if one is already waiting or the timer is held.
+unsigned queuePulse( const unsigned * lines , unsigned long riseAt , unsigned long widthUs ,
+                     unsigned count = 1 , unsigned long periodUs = 0 ) ;
+
+// True while a queued pulse is still waiting to rise.  Once the first
+// pulse of a burst rises, the queue is free for the next one.
+bool pulsePending() ;
+
+// True from the moment a pulse is queued until its falling edge
+bool pulseBusy() ;
+
+// True while the lines are raised
+bool pulseHigh() ;
+
+// Fetch the next edge emitted by the timer.  Returns false if none.
+bool readPulseEdge( PulseEdge & edge ) ;
+
+// Number of edge reports lost because the loop did not keep up
+unsigned pulseEdgeDrops() ;
+
+// A pulse that has been high this long has stepped the movement
+#define MIN_STEP_US 50000
+
+// Drop the lines at once and send nothing more until released.  The
+// queued pulse and the rest of any burst are thrown away.  Safe to call
+// from an interrupt handler.
+void pulseHold() ;
+void pulseRelease() ;
+bool pulseHeld() ;
+
+// Where the last hold caught the timer: the ticket of the pulse it was
+// sending, and how many pulses of that burst reached the movement.  A
+// pulse cut short before MIN_STEP_US does not count.
+void pulseHoldProgress( unsigned & ticket , unsigned & delivered ) ;
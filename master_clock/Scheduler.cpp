@@ -0,0 +1,132 @@
+/*
+    Master Clock - Drives an IBM Impulse Secondary clock movement
+    using the International Business Machine Time Protocols,
+    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+    By Phil Hord,  This code is in the public domain Sept 9, 2013
+*/
+
+//_____________________________________________________________________
+//                                                             INCLUDES
+#include "Arduino.h"
+#include <coredecls.h>          // esp_delay(), esp_schedule()
+#include "Scheduler.h"
+#include "Profiler.h"
+
+//_____________________________________________________________________
+//                                                            CONSTANTS
+
+// Longest we will sleep, even if nobody wants to run.  This bounds how
+// late a task that was registered from outside runTasks() can start.
+#define MAX_SLEEP_MS    1000
+
+// Define SCHEDULER_BUSY_POLL to run every task on every pass like the old
+// service() loop.  Useful to compare the wakeup rate.
+//#define SCHEDULER_BUSY_POLL
+
+//_____________________________________________________________________
+//                                                           LOCAL VARS
+
+static Task tasks[MAX_TASKS] ;             ///< Registered tasks
+static uint32_t deadline[MAX_TASKS] ;      ///< When each task is due, in millis()
+static int nTasks = 0 ;
+static volatile bool woken[MAX_TASKS] ;    ///< Made due by wakeTask()
+static volatile bool wakeup = false ;      ///< Some task was woken
+static int profile[MAX_TASKS] ;            ///< Profiler slot of each task
+static int betweenPasses ;                 ///< Profiler slot for the core and WiFi
+#ifdef PROFILE_LOOP
+static uint32_t passEnd = 0 ;              ///< Cycle count when runTasks() returned
+#endif
+
+static unsigned wakeups = 0 ;              ///< Wakeups counted this second
+static unsigned wakeupRate = 0 ;           ///< Wakeups counted last second
+static uint32_t wakeupSecond = 0 ;         ///< Start of the counting window
+static unsigned long loopLast = 0 ;        ///< Microseconds running tasks, last pass
+static unsigned long loopWorst = 0 ;
+
+//_____________________________________
+// True if the deadline has arrived.  Wrap-safe for deadlines within 24 days.
+// millis() is 32 bits on the ESP; the explicit widths keep the wrap
+// where it is on a host with 64-bit longs.
+[[maybe_unused]] static bool due( uint32_t when, uint32_t now ) {    // Not with SCHEDULER_BUSY_POLL
+  return (int32_t) (now - when) >= 0 ;
+}
+
+void addTask( Task task , const char * name ) {
+  if ( nTasks >= MAX_TASKS ) {
+    Serial.println( "Too many tasks; raise MAX_TASKS" ) ;
+    return ;
+  }
+  if ( !nTasks ) betweenPasses = profileSlot( "core/WiFi" ) ;
+  profile[nTasks] = profileSlot( name ) ;
+  tasks[nTasks] = task ;
+  deadline[nTasks] = millis() ;
+  nTasks++ ;
+}
+
+void IRAM_ATTR wakeTask( Task task ) {
+  for ( int i = 0 ; i < nTasks ; i++ )
+    if ( tasks[i] == task ) woken[i] = true ;
+  wakeup = true ;
+  esp_schedule() ;
+}
+
+// Time the core and WiFi stack spent between passes, outside our sleep
+static void passDone() {
+#ifdef PROFILE_LOOP
+  passEnd = ESP.getCycleCount() ;
+#endif
+}
+
+void runTasks() {
+#ifdef PROFILE_LOOP
+  if ( passEnd ) profileEnd( betweenPasses , passEnd ) ;
+#endif
+
+  uint32_t now = millis() ;
+  wakeup = false ;
+
+  ++wakeups ;
+  if ( now - wakeupSecond >= 1000 ) {
+    wakeupRate = wakeups ;
+    wakeups = 0 ;
+    wakeupSecond = now ;
+    profileTick() ;
+  }
+
+  auto start = micros() ;
+  for ( int i = 0 ; i < nTasks ; i++ ) {
+#ifndef SCHEDULER_BUSY_POLL
+    if ( !woken[i] && !due(deadline[i], now) ) continue ;
+#endif
+    woken[i] = false ;
+    ProfileScope scope( profile[i] ) ;
+    deadline[i] = millis() + tasks[i]() ;
+  }
+  loopLast = micros() - start ;
+  if ( loopLast > loopWorst ) loopWorst = loopLast ;
+
+#ifndef SCHEDULER_BUSY_POLL
+  // Sleep until the earliest deadline, or until an interrupt wakes a
+  // task.  Like delay(), this yields to the WiFi stack.
+  now = millis() ;
+  uint32_t sleep = MAX_SLEEP_MS ;
+  for ( int i = 0 ; i < nTasks ; i++ ) {
+    if ( woken[i] || due(deadline[i], now) ) { passDone() ; return ; }
+    if ( deadline[i] - now < sleep ) sleep = deadline[i] - now ;
+  }
+  esp_delay( sleep , []() { return !wakeup ; } ) ;
+#endif
+  passDone() ;
+}
+
+unsigned getWakeupRate() {
+  return wakeupRate ;
+}
+
+unsigned long getLoopTime() {
+  return loopLast ;
+}
+
+unsigned long getLoopWorst() {
+  return loopWorst ;
+}
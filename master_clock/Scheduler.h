@@ -0,0 +1,39 @@
+// Scheduler.h
+//
+// Deadline-driven cooperative task scheduler
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Each subsystem is a task that does its work and then returns how many
+// milliseconds it can sleep before it needs to run again.  The main loop
+// runs whatever is due and then sleeps until the earliest deadline instead
+// of spinning through every service routine on every pass.
+
+// Run the task; return milliseconds until it wants to run again
+typedef unsigned long (*Task)();
+
+// Room for this many tasks.  The sketch checks its task table against it
+// at compile time.
+#define MAX_TASKS       16
+
+// Register a task.  It runs on the next call to runTasks().  The name
+// labels it in the profiler, and must stay put.  Past MAX_TASKS the task
+// is refused with an error on the serial port.
+void addTask( Task task , const char * name = "task" ) ;
+
+// Run all due tasks, then sleep until the next deadline.  Call from loop().
+void runTasks() ;
+
+// Make a task due now and cut the scheduler's sleep short.  Safe to call
+// from an interrupt handler.
+void wakeTask( Task task ) ;
+
+// Number of times runTasks() woke up during the last full second
+unsigned getWakeupRate() ;
+
+// Microseconds spent running tasks in the last pass, and the worst pass
+unsigned long getLoopTime() ;
+unsigned long getLoopWorst() ;
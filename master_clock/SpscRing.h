@@ -0,0 +1,67 @@
+// SpscRing.h
+//
+// Lock-free single-producer/single-consumer ring buffer
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// One side (usually an interrupt handler) pushes and the other (the main
+// loop) pops.  Neither side ever blocks or disables interrupts.  The
+// indices run freely and are reduced modulo N on access, so N must be a
+// power of two.  A push to a full ring is dropped and counted.
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+
+template <typename T, unsigned N>
+class SpscRing
+{
+        static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+        // Producer side.  Returns false if the ring is full.  Always
+        // inlined, so a push from an interrupt handler runs from IRAM
+        // with its caller instead of from flash.
+        __attribute__((always_inline)) bool push(const T & item)
+        {
+                unsigned h = head.load(std::memory_order_relaxed);
+                if (h - tail.load(std::memory_order_acquire) >= N) {
+                        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                        return false;
+                }
+                buf[h % N] = item;
+                head.store(h + 1, std::memory_order_release);
+                return true;
+        }
+
+        // Consumer side.  Returns false if the ring is empty.
+        bool pop(T & item)
+        {
+                unsigned t = tail.load(std::memory_order_relaxed);
+                if (t == head.load(std::memory_order_acquire)) return false;
+                item = buf[t % N];
+                tail.store(t + 1, std::memory_order_release);
+                return true;
+        }
+
+        // Number of items waiting.  Exact only from the consumer side.
+        unsigned size() const
+        {
+                return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+        }
+
+        // Number of pushes lost because the ring was full
+        unsigned drops() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+        T buf[N];
+        std::atomic<unsigned> head { 0 };
+        std::atomic<unsigned> tail { 0 };
+        std::atomic<unsigned> dropped { 0 };
+};
+
+#endif
@@ -1,5 +1,12 @@
 //================================================================================
 // TelnetServer
+//
+// Serves the console to several telnet clients at once.  Each client has
+// its own output queue.  TelnetWrite() only copies into the queues, and
+// serviceTelnetServer() drains them as fast as each client's socket will
+// take data.  A client that falls behind loses the output that does not
+// fit in its queue, and a client that stays stuck is disconnected, so one
+// stalled connection never holds up the clock.
 
 /* Library imports */
 #include <SPI.h>
@@ -11,38 +18,156 @@
 #include <WiFiClientSecure.h>
 
 #include "clock_generic.h"
+#include "console.h"
+#include "TelnetServer.h"
+
+#define MAX_TELNET_CLIENTS      3
+#define TELNET_QUEUE            512     // Output bytes buffered per client
+#define TELNET_STALL_MS         10000   // Disconnect a client stuck this long
+
+struct TelnetClient {
+    WiFiClient client ;
+    char queue[TELNET_QUEUE] ;
+    unsigned head , tail ;              ///< Free-running queue indices
+    unsigned long sent ;                ///< Bytes written to the socket
+    unsigned long dropped ;             ///< Bytes dropped because the queue was full
+    unsigned highWater ;                ///< Most bytes ever waiting in the queue
+    unsigned long stalledSince ;        ///< millis() when the queue filled up; 0 if not full
+} ;
 
 WiFiServer telnet_server(23);  // create a server at port 23
-WiFiClient telnet_client ;
+static TelnetClient clients[MAX_TELNET_CLIENTS] ;
+static bool started = false ;
+static int nextReader = 0 ;             ///< Round-robin input between clients
 
+static void dropClient( TelnetClient & c ) ;
+
+// Start listening, or start over after the network came back.  Clients
+// from before are gone with the old link.
 void setupTelnetServer()
 {
+    for ( auto & c : clients )
+        if ( c.client ) dropClient( c ) ;
     telnet_server.begin();           // start to listen for clients
+    telnet_server.setNoDelay(true);
+    started = true ;
 }
 
 int TelnetRead()
 {
-    int key = -1 ;
-    if ( telnet_client )
-        if ( telnet_client.available() )
-            key = telnet_client.read();
-    return key ;
+    // Take input from each client in turn so one can't starve the others
+    for ( int i = 0 ; i < MAX_TELNET_CLIENTS ; i++ )
+    {
+        auto & c = clients[ (nextReader + i) % MAX_TELNET_CLIENTS ] ;
+        if ( c.client && c.client.available() )
+        {
+            nextReader = (nextReader + i + 1) % MAX_TELNET_CLIENTS ;
+            return c.client.read();
+        }
+    }
+    return -1 ;
 }
 
 int TelnetWrite( const char * str )
 {
-    return telnet_server.write( (uint8_t *) str , (size_t) strlen(str) );
+    unsigned len = strlen(str) ;
+    for ( auto & c : clients )
+    {
+        if ( ! c.client ) continue ;
+
+        unsigned used = c.head - c.tail ;
+        unsigned n = len ;
+        if ( n > TELNET_QUEUE - used )
+        {
+            // Trim what doesn't fit rather than wait for the client
+            n = TELNET_QUEUE - used ;
+            c.dropped += len - n ;
+            if ( ! c.stalledSince ) c.stalledSince = millis() | 1 ;
+        }
+        for ( unsigned i = 0 ; i < n ; i++ )
+            c.queue[ (c.head + i) % TELNET_QUEUE ] = str[i] ;
+        c.head += n ;
+
+        used += n ;
+        if ( used > c.highWater ) c.highWater = used ;
+    }
+    return len ;
 }
 
-void serviceTelnetServer()
+// Write as much queued output as the socket will take without blocking
+static void flushClient( TelnetClient & c )
 {
-    if ( telnet_client && ! telnet_client.connected() )
-        telnet_client.stop() ;
+    while ( c.head != c.tail )
+    {
+        int room = c.client.availableForWrite() ;
+        if ( room <= 0 ) break ;
+
+        // Write the contiguous run up to the end of the buffer
+        unsigned start = c.tail % TELNET_QUEUE ;
+        unsigned n = c.head - c.tail ;
+        if ( n > TELNET_QUEUE - start ) n = TELNET_QUEUE - start ;
+        if ( n > (unsigned) room ) n = room ;
+
+        auto wrote = c.client.write( (const uint8_t *) c.queue + start , n ) ;
+        if ( ! wrote ) break ;
+        c.tail += wrote ;
+        c.sent += wrote ;
+        c.stalledSince = 0 ;
+    }
+}
 
-    if ( ! telnet_client )
+// Reset the connection rather than close it: stop() waits up to 300ms
+// for a stalled client to take what is queued, blocking the loop.
+static void dropClient( TelnetClient & c )
+{
+    c.client.abort() ;
+    c.head = c.tail = 0 ;
+    c.stalledSince = 0 ;
+}
+
+unsigned long serviceTelnetServer()
+{
+    if ( ! started ) return 100 ;
+
+    for ( auto & c : clients )
+    {
+        if ( c.client && ! c.client.connected() )
+            dropClient( c ) ;
+
+        if ( c.client ) flushClient( c ) ;
+
+        if ( c.client && c.stalledSince && millis() - c.stalledSince > TELNET_STALL_MS )
+        {
+            p( "\nTelnet client stalled; disconnected\n" ) ;
+            dropClient( c ) ;
+        }
+    }
+
+    while ( telnet_server.hasClient() )
     {
-        telnet_client = telnet_server.available() ;
+        TelnetClient * slot = nullptr ;
+        for ( auto & c : clients )
+            if ( ! c.client ) { slot = &c ; break ; }
 
-        // if ( telnet_client ) ShowConfig() ;
+        auto client = telnet_server.available() ;
+        if ( ! slot ) { client.abort() ; break ; }
+
+        *slot = TelnetClient() ;
+        slot->client = client ;
+        slot->client.setNoDelay(true) ;
+    }
+
+    return 20 ;
+}
+
+void showTelnetStats()
+{
+    p( "\n" ) ;
+    for ( int i = 0 ; i < MAX_TELNET_CLIENTS ; i++ )
+    {
+        auto & c = clients[i] ;
+        if ( ! c.client ) continue ;
+        p( "Telnet %d: sent %lu, dropped %lu, queued %u, high water %u\n" ,
+           i , c.sent , c.dropped , c.head - c.tail , c.highWater ) ;
     }
 }
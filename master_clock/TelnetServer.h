@@ -1,4 +1,10 @@
 void setupTelnetServer() ;
-void serviceTelnetServer() ;
-char TelnetRead() ;
+int TelnetRead() ;
 int TelnetWrite( const char * str ) ;
+
+// Accept clients and drain their output queues.  Returns milliseconds
+// until it wants to be called again.
+unsigned long serviceTelnetServer() ;
+
+// Report per-client byte, drop and queue statistics on the console
+void showTelnetStats() ;
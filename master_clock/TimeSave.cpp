@@ -1,43 +1,196 @@
 #include <FS.h>
 #include <LittleFS.h>
 #include <time.h>
+#include <stddef.h>
 
 #include "TimeSave.h"
 #include "clock_generic.h"
 #include "console.h"
+#include "TimeService.h"
+#include "Metrics.h"
+#include "Inputs.h"
 
-#define POWERLOSS_FILE "clockface.txt"
+// Channel 0 keeps its journal in JOURNAL_FILE, the others in
+// clockface1.bin, clockface2.bin and so on
+#define JOURNAL_FILE "clockface.bin"
+#define JOURNAL_NAME "clockface%d.bin"
+#define LEGACY_FILE "clockface.txt"
+
+// Number of record slots in the journal file
+#define JOURNAL_SLOTS 64
+
+// Write the flash journal when it is this many minutes behind the face.
+// Every minute goes to RTC memory, which survives resets but not power cuts.
+// Only with a power-fail input, which saves the face as the supply goes.
+#define FLASH_SAVE_MINUTES 10
+
+// Write the journal even outside a quiet window once it is this far behind
+#define FLASH_STALE_MINUTES 30
+
+// How many seconds without a pulse make a quiet window for a flash write
+#define QUIET_SECONDS 3
+
+// RTC user memory offset of channel 0, in 4-byte blocks.  The other
+// channels follow it.
+#define RTC_OFFSET 0
+#define RTC_MAGIC 0x436c6b46    // "ClkF"
 
 //#define DEBUG_POWERLOSS_FILE
 
-static int prev_time = -1;
+/** The clock face time is kept in a fixed-size journal of binary records.
+Each save overwrites the slot after the newest one, so the file never
+grows and never has to be rewritten.  Every record carries a sequence
+number and a CRC; on startup we read every slot and keep the newest
+record whose CRC checks out.  A write torn by a power cut only damages
+the slot being written, and the one before it still holds the previous
+minute.
+
+The filesystem stays mounted and the journal stays open after the first
+use, since mounting LittleFS alone takes many milliseconds.
+
+Each minute is first saved to the ESP8266 RTC user memory, which takes
+microseconds and keeps its contents across watchdog and software resets.
+At startup a valid RTC record wins over the journal.
 
-/** Note: I save multiple time values in the file and then only keep then
-last time added. I do this on the assumption that appending to the file
-will not cause extra wear-leveling that overwriting will. But I don't know
-enough about LittleFS to know if this is really true. Maybe this is a
-waste of time.  And it does take time.  Mounting the FS or something in here
-takes many milliseconds. Probably we should yield in here or something.
+RTC memory does not survive a power cut.  With a power-fail input wired,
+its interrupt holds the pulses and the power task commits the face with
+commitTime() while the supply holds up, so the journal only has to catch
+up every FLASH_SAVE_MINUTES, or when asked with flushTime().  Without
+one, POWER_PIN -1 in the sketch, nothing warns of a cut and every minute
+goes to the journal.
+
+Flash writes are kept off the pulse path: saveService() only writes the
+journal when the pulse schedule has a few quiet seconds ahead, which
+rules out the correction burst in minute 59 and fast catch-up runs.  If
+no quiet window turns up the journal is written anyway once it falls
+FLASH_STALE_MINUTES behind, or a minute behind when unwired, right after
+a pulse has dropped.
+
+Each channel has its own journal file and RTC record.  Only channel 0
+falls back to the legacy text file, which predates channels.
 */
 
+struct Record {
+  uint32_t seq;         ///< Increases by one with every save
+  uint16_t minutes;     ///< Clock face time, minutes past 12:00
+  uint16_t crc;         ///< CRC-16 of the fields above
+};
+
+struct RtcRecord {
+  uint32_t magic;
+  uint16_t minutes;
+  uint16_t crc;         ///< CRC-16 of the fields above
+};
+
+// Save state of one channel
+struct Journal {
+  int prev_time = -1;           ///< Face time last saved anywhere, in minutes
+  int flash_time = -1;          ///< Face time last saved to the journal
+  uint32_t seq = 0;             ///< Sequence number of the newest record
+  int slot = -1;                ///< Slot holding the newest record
+  File file;
+};
+
+static Journal journals[NUM_CHANNELS];
+static bool mounted = false;
+
+// Latency measurements, in microseconds.  RTC and flash saves differ by
+// orders of magnitude, so each has its own.
+static unsigned long rtcLast = 0, rtcWorst = 0;
+static unsigned long flashLast = 0, flashWorst = 0;
+static unsigned long readLast = 0;
+static unsigned saves = 0, flashSaves = 0;
+
+// CRC-16/CCITT-FALSE
+uint16_t crc16(const uint8_t * data, size_t len)
+{
+  uint16_t crc = 0xFFFF;
+  while (len--) {
+    crc ^= (uint16_t) *data++ << 8;
+    for (int i = 0; i < 8; i++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+static uint16_t recordCrc(const Record & rec)
+{
+  return crc16((const uint8_t *) &rec, offsetof(Record, crc));
+}
+
+static uint16_t recordCrc(const RtcRecord & rec)
+{
+  return crc16((const uint8_t *) &rec, offsetof(RtcRecord, crc));
+}
+
+// RTC user memory block holding the channel's record
+static uint32_t rtcOffset(int channel)
+{
+  return RTC_OFFSET + channel * (sizeof(RtcRecord) / 4);
+}
+
+// Read the face time from RTC memory; -1 if it does not hold a valid record
+static int readRtcTime(int channel)
+{
+  RtcRecord rec;
+  if (!ESP.rtcUserMemoryRead(rtcOffset(channel), (uint32_t *) &rec, sizeof(rec))) return -1;
+  if (rec.magic != RTC_MAGIC || rec.crc != recordCrc(rec)) return -1;
+  if (rec.minutes >= MAX_TIME/60) return -1;
+  return rec.minutes;
+}
 
-// Get last displayed walltime in seconds
-int readTime()
+static bool saveRtcTime(int channel, int t)
 {
-  if (!LittleFS.begin()) {
-    p("LittleFS mount failed\n");
-    return -1;
+  RtcRecord rec;
+  rec.magic = RTC_MAGIC;
+  rec.minutes = t;
+  rec.crc = recordCrc(rec);
+  return ESP.rtcUserMemoryWrite(rtcOffset(channel), (uint32_t *) &rec, sizeof(rec));
+}
+
+// Mount the filesystem and open the channel's journal, creating it if needed
+static bool openJournal(int channel)
+{
+  auto & journal = journals[channel].file;
+  if (journal) return true;
+
+  if (!mounted && !LittleFS.begin()) {
+    plog(LOG_ERROR, "LittleFS mount failed\n");
+    return false;
   }
+  mounted = true;
+
+  char name[20] = JOURNAL_FILE;
+  if (channel) snprintf(name, sizeof(name), JOURNAL_NAME, channel);
 
-  File file = LittleFS.open(POWERLOSS_FILE, "r");
-  if (!file) {
-    p("File read failed: " POWERLOSS_FILE "\n");
+  if (LittleFS.exists(name)) {
+    journal = LittleFS.open(name, "r+");
+    if (journal && journal.size() == JOURNAL_SLOTS * sizeof(Record))
+      return true;
+    if (journal) journal.close();
   }
 
-#ifdef DEBUG_POWERLOSS_FILE
-  p("<size: %d>", file.size());
-#endif
-  
+  // Preallocate every slot.  Erased records never pass the CRC check.
+  journal = LittleFS.open(name, "w+");
+  if (!journal) {
+    plog(LOG_ERROR, "Journal create failed, channel %d\n", channel);
+    return false;
+  }
+  Record blank;
+  memset(&blank, 0xFF, sizeof(blank));
+  for (int i = 0; i < JOURNAL_SLOTS; i++)
+    journal.write((const uint8_t *) &blank, sizeof(blank));
+  journal.flush();
+  journals[channel].slot = -1;
+  return true;
+}
+
+// Read the time from the old text file, for the first boot after an upgrade
+static int readLegacyTime()
+{
+  File file = LittleFS.open(LEGACY_FILE, "r");
+  if (!file) return -1;
+
   if (file.size() > 20) {
         // read the last 20 bytes of the file.
         file.seek(file.size() - 20);
@@ -47,68 +200,183 @@ int readTime()
 
   int t = -1;
   while (file.available()) {
-        // TODO: better value validation
+        // The old format wrote t+1 because parseInt("bogus")==0
         auto rt = file.parseInt() - 1;
-#ifdef DEBUG_POWERLOSS_FILE
-        p("<read: %d>", rt+1);
-#endif        
         if (rt >= 0 && rt < MAX_TIME/60) t = rt;
   }
   file.close();
-  LittleFS.end();
-
-  prev_time = t;
-  return t * 60;
+  return t;
 }
 
-// Save current displayed walltime to flash
-bool saveTime()
+// Find the newest valid record in the channel's journal
+static int readJournalTime(int channel)
 {
-  // Note: We record the time in minutes since we do not have a second-hand
-  auto t = getWallTime() / 60;
-  if (t == prev_time) return false;
+  if (!openJournal(channel)) return -1;
 
-  if (!LittleFS.begin()) {
-    p("LittleFS mount failed\n");
-    return false;
+  auto & j = journals[channel];
+  int t = -1;
+  j.slot = -1;
+  j.file.seek(0);
+  for (int i = 0; i < JOURNAL_SLOTS; i++) {
+    Record rec;
+    if (j.file.read((uint8_t *) &rec, sizeof(rec)) != sizeof(rec)) break;
+    if (rec.crc != recordCrc(rec) || rec.minutes >= MAX_TIME/60) continue;
+    if (j.slot >= 0 && (int32_t) (rec.seq - j.seq) <= 0) continue;
+    j.slot = i;
+    j.seq = rec.seq;
+    t = rec.minutes;
   }
 
-  bool append = true;
-  File file = LittleFS.open(POWERLOSS_FILE, "a");
-  if (!file) {
-    p("File append failed: " POWERLOSS_FILE "\n");
-  }
-  if (!file || file.size() > 4000) {
-        append = false;
-        if (file) file.close();
-        file = LittleFS.open(POWERLOSS_FILE, "w");
-        if (!file) {
-                p("File save failed: " POWERLOSS_FILE "\n");
-                return false;
-        }
-  }
+#ifdef DEBUG_POWERLOSS_FILE
+  p("<read %d: slot %d seq %u>", channel, j.slot, j.seq);
+#endif
+
+  if (t < 0 && channel == 0) t = readLegacyTime();
+  return t;
+}
+
+// Get last displayed walltime of the channel in seconds
+int readTime(int channel)
+{
+  auto start = micros();
+  auto & j = journals[channel];
+
+  // Read the journal even if RTC memory is good, to find the newest slot
+  j.flash_time = readJournalTime(channel);
+  int t = readRtcTime(channel);
+#ifdef DEBUG_POWERLOSS_FILE
+  p("<rtc: %d flash: %d>", t, j.flash_time);
+#endif
+  if (t < 0) t = j.flash_time;
+
+  readLast = micros() - start;
+  j.prev_time = t;
+  return t * 60;
+}
+
+// Write the face time to the next slot of the channel's journal
+static bool saveJournalTime(int channel, int t)
+{
+  if (!openJournal(channel)) return false;
 
-  // We write t+1 because parseInt("bogus")==0
-  bool saved = file.println(t+1);
+  auto & j = journals[channel];
+  Record rec;
+  rec.seq = j.seq + 1;
+  rec.minutes = t;
+  rec.crc = recordCrc(rec);
+
+  int next = (j.slot + 1) % JOURNAL_SLOTS;
+  bool saved = j.file.seek(next * sizeof(Record)) &&
+      j.file.write((const uint8_t *) &rec, sizeof(rec)) == sizeof(rec);
+  j.file.flush();
 
   if (saved) {
-    file.close();
-    prev_time = t;
+    j.slot = next;
+    j.seq = rec.seq;
+    j.flash_time = t;
+    ++flashSaves;
 #ifdef DEBUG_POWERLOSS_FILE
-    p("<save[%c] %d>", append?'a':'w', t+1);
+    p("<save %d[%d] %d>", channel, j.slot, t);
 #endif
   } else {
-    p("<save-failed>");
-    file.close();
+    plog(LOG_ERROR, "<save-failed>");
   }
-  LittleFS.end();
+  return saved;
+}
 
-#ifdef DEBUG_POWERLOSS_FILE
-  if (saved) {
-    auto verify = readTime() / 60;
-    if (t != verify) p("wtf? read-time doesn't match: %d != %d\n", t, verify);
-  }
-#endif
+// Minutes the channel's journal lags behind the face time
+static int flashLag(const Journal & j)
+{
+  if (j.flash_time < 0) return MAX_TIME/60;
+  return (MAX_TIME/60 + j.prev_time - j.flash_time) % (MAX_TIME/60);
+}
+
+// Save the channel's displayed walltime to RTC memory.  saveService()
+// takes it to flash later.
+bool saveTime(int channel)
+{
+  // Note: We record the time in minutes since we do not have a second-hand
+  auto t = getWallTime(channel) / 60;
+  auto & j = journals[channel];
+  if (t == j.prev_time) return false;
+
+  auto start = micros();
+  bool saved = saveRtcTime(channel, t);
+  if (saved) j.prev_time = t;
 
+  rtcLast = micros() - start;
+  if (rtcLast > rtcWorst) rtcWorst = rtcLast;
+  ++saves;
+
+  return saved;
+}
+
+// Write a channel's face time to RTC memory and flash right away
+bool commitTime(int channel, int seconds)
+{
+  auto t = seconds / 60;
+  auto & j = journals[channel];
+  saveRtcTime(channel, t);
+  j.prev_time = t;
+  if (t == j.flash_time) return true;
+
+  auto start = micros();
+  bool saved = saveJournalTime(channel, t);
+  flashLast = micros() - start;
+  if (flashLast > flashWorst) flashWorst = flashLast;
+  return saved;
+}
+
+// Bring the channel's flash journal up to date with its face time
+static bool flushTime(int channel)
+{
+  return commitTime(channel, getWallTime(channel));
+}
+
+// Bring every flash journal up to date with the face times
+bool flushTime()
+{
+  bool saved = true;
+  for (int c = 0; c < NUM_CHANNELS; c++)
+    saved &= flushTime(c);
   return saved;
 }
+
+// Write the journals in a quiet window of the pulse schedule.  Without a
+// power-fail input nothing saves the face when the supply goes, so every
+// minute goes to flash, as it did before RTC memory.
+unsigned long saveService()
+{
+  int saveLag = powerWired() ? FLASH_SAVE_MINUTES : 1;
+  int staleLag = powerWired() ? FLASH_STALE_MINUTES : 1;
+
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    auto & j = journals[c];
+    if (j.prev_time < 0) continue;
+    auto lag = flashLag(j);
+    if ((lag >= saveLag && pulseQuiet(QUIET_SECONDS)) ||
+        (lag >= staleLag && pulseQuiet(0)))
+      flushTime(c);
+  }
+
+  // Look again after the next pulse would have dropped
+  return TimeService::msUntilNextSecond() + 700;
+}
+
+// Report save/restore latencies
+void showSaveStats()
+{
+  p("\nSaves: %u to RTC, last %luus, worst %luus\n", saves, rtcLast, rtcWorst);
+  p("  %u to flash every %d min, last %luus, worst %luus; restore %luus\n",
+    flashSaves, powerWired() ? FLASH_SAVE_MINUTES : 1, flashLast, flashWorst, readLast);
+}
+
+void writeSaveMetrics(MetricsBuffer & m)
+{
+  m.counter("clock_saves_total", "Face times saved to RTC memory", saves);
+  m.counter("clock_flash_saves_total", "Face times saved to the flash journal", flashSaves);
+  m.gauge("clock_rtc_save_microseconds", "Latency of the last RTC memory save", rtcLast);
+  m.gauge("clock_rtc_save_worst_microseconds", "Worst RTC memory save latency", rtcWorst);
+  m.gauge("clock_flash_save_microseconds", "Latency of the last flash journal save", flashLast);
+  m.gauge("clock_flash_save_worst_microseconds", "Worst flash journal save latency", flashWorst);
+}
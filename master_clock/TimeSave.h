@@ -1,3 +1,27 @@
-// Save the time in a file in flash, hopefully in a safe way
-bool saveTime();
-int readTime();
+#include <stdint.h>
+#include <stddef.h>
+
+// Save a channel's face time in RTC memory and, every few minutes, in flash
+bool saveTime(int channel);
+int readTime(int channel);
+
+// Write every channel's time to flash right away
+bool flushTime();
+
+// Write a channel's face time, in seconds, to RTC memory and flash right
+// away.  For a power failure, when the face is not where walltime says.
+bool commitTime(int channel, int seconds);
+
+// Write the time to flash when the pulse schedule is quiet.  Returns
+// milliseconds until it wants to run again.
+unsigned long saveService();
+
+// CRC-16/CCITT-FALSE, for checking records kept in flash or RTC memory
+uint16_t crc16(const uint8_t * data, size_t len);
+
+// Report save/restore latencies on the console
+void showSaveStats();
+
+// Write save counts and latencies
+class MetricsBuffer;
+void writeSaveMetrics(MetricsBuffer & m);
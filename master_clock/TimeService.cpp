@@ -2,6 +2,7 @@
 #include <time.h>                       // time() ctime()
 #include <sys/time.h>                   // struct timeval
 #include <coredecls.h>                  // settimeofday_cb()
+#include <limits.h>                     // LONG_MAX
 
 #include "TimeService.h"
 #include "clock_generic.h"
@@ -11,17 +12,42 @@
 extern "C" int settimeofday(const struct timeval *, const struct timezone *);
 
 
-#define STALE_TIME    (5*60*60)         // Stale is when we have no updates for 5 hours
+#define STALE_ERROR_US  500000L         // Stale is when the clock may be half a second off
+
+// The error bound grows from the error at the last update at the drift rate
+#define UNKNOWN_DRIFT_PPB 30000L        // Untrained crystal; stale after about 5 hours
 
 static time_t updated = 0;
+static long updateError = 0;            // Clock error at the last update, in microseconds
+static long driftError = UNKNOWN_DRIFT_PPB;
+static unsigned nudges = 0;             // Clock shifts settime_cb() should let pass
+
+// Next change of the local UTC offset, found by nextTransition()
+static time_t transitionAt = 0;
+static long transitionChange = 0;
+static bool transitionSearched = false;
+
+// UTC offset cached for localtime().  It holds from offsetFrom until
+// offsetUntil, the next transition or the next hourly recheck.
+static long cachedOffset = 0;
+static time_t offsetFrom = 0;
+static time_t offsetUntil = 0;
+
+#define OFFSET_RECHECK  3600            // Recheck this often when no transition is known
 
 static void settime_cb() {
         // everything is allowed in this function
 
-        static unsigned long firstNtp = 0 ;    ///< First sync time
+        // A slew step moves the clock by microseconds; nothing to redo
+        if (nudges) {
+                --nudges;
+                return;
+        }
 
         auto now = time(nullptr);
         updated = now;
+        transitionSearched = false;     // The clock may have jumped past it
+        offsetUntil = 0;                // and the cached offset with it
 
         unsigned hh = (now % 86400L) / 3600 ;
         unsigned mm = (now  % 3600) / 60;
@@ -59,18 +85,101 @@ bool TimeService::hasBeenSynced()
 // Do we consider the current time to be unreliable
 bool TimeService::isStale()
 {
-        return !hasBeenSynced() || timeSinceUpdate() > STALE_TIME;
+        return !hasBeenSynced() || errorBound() > STALE_ERROR_US;
+}
+
+// How far off the clock may be now
+long TimeService::errorBound()
+{
+        auto age = timeSinceUpdate();
+        if (age < 0) return LONG_MAX;
+
+        long long bound = updateError + (long long) age * driftError / 1000;
+        return bound < LONG_MAX ? bound : LONG_MAX;
 }
 
-// Return the current localtime
+// Return the current localtime, as seconds since local midnight
+//
+// The TZ rules are only evaluated when the cached UTC offset runs out:
+// at the next DST transition, after an hour if none is known, or when
+// the clock is set.  Otherwise this is integer arithmetic on time().
 time_t TimeService::localtime()
 {
         auto now = time(nullptr);
-        auto tm = ::localtime(&now);
+        if (now < offsetFrom || now >= offsetUntil) {
+                time_t when;
+                long change;
+                cachedOffset = utcOffset(now);
+                offsetFrom = now;
+                offsetUntil = now + OFFSET_RECHECK;
+                if (nextTransition(when, change) && when > now) offsetUntil = when;
+        }
+
+        time_t local = (now + cachedOffset) % 86400L;
+        return local < 0 ? local + 86400L : local;
+}
+
+// Time until the system clock reaches the next whole second
+unsigned long TimeService::msUntilNextSecond()
+{
+        return (usUntilNextSecond() + 999) / 1000;
+}
 
-        // Convert localtime structure to epoch time representation
-        time_t local = tm->tm_hour * 3600 + tm->tm_min * 60 + tm->tm_sec;
-        return local ;
+unsigned long TimeService::usUntilNextSecond()
+{
+        timeval tv;
+        gettimeofday(&tv, nullptr);
+        return 1000000 - tv.tv_usec;
+}
+
+// Local time minus UTC at the given moment, in seconds
+long TimeService::utcOffset(time_t t)
+{
+        struct tm lt = *::localtime(&t);
+        struct tm gt = *::gmtime(&t);
+
+        long days = lt.tm_yday - gt.tm_yday;
+        if (days > 1) days = -1;                // Local time is still last year
+        else if (days < -1) days = 1;           // Local time is already next year
+        return days * 86400L + (lt.tm_hour - gt.tm_hour) * 3600L +
+                (lt.tm_min - gt.tm_min) * 60L + (lt.tm_sec - gt.tm_sec);
+}
+
+// Find the next change of the UTC offset in the coming year.  The TZ
+// rules are probed every six hours, then the step that changed is
+// narrowed down to the second.  The answer is kept until it passes or
+// the clock is set.
+bool TimeService::nextTransition(time_t & when, long & change)
+{
+        auto now = time(nullptr);
+        if (!hasBeenSynced()) return false;
+
+        if (!transitionSearched || (transitionAt && now >= transitionAt)) {
+                transitionSearched = true;
+                transitionAt = 0;
+
+                const long step = 6 * 3600L;
+                auto offset = utcOffset(now);
+                for (time_t t = now + step; t < now + 366 * 86400L; t += step) {
+                        if (utcOffset(t) == offset) continue;
+
+                        // The change is in (t - step, t]
+                        time_t lo = t - step, hi = t;
+                        while (hi - lo > 1) {
+                                time_t mid = lo + (hi - lo) / 2;
+                                if (utcOffset(mid) == offset) lo = mid;
+                                else hi = mid;
+                        }
+                        transitionAt = hi;
+                        transitionChange = utcOffset(hi) - offset;
+                        break;
+                }
+        }
+
+        if (!transitionAt) return false;
+        when = transitionAt;
+        change = transitionChange;
+        return true;
 }
 
 // Set the system time from some authoritative source
@@ -81,3 +190,24 @@ void TimeService::setTime(time_t epoch)
         timeval tv = { epoch, 0 };
         settimeofday(&tv, nullptr);
 }
+
+// Move the system clock by `us` microseconds
+void TimeService::shiftClock(long long us, bool nudge)
+{
+        timeval tv;
+        gettimeofday(&tv, nullptr);
+        long long t = tv.tv_sec * 1000000LL + tv.tv_usec + us;
+        tv.tv_sec = t / 1000000;
+        tv.tv_usec = t % 1000000;
+
+        if (nudge) ++nudges;
+        settimeofday(&tv, nullptr);
+}
+
+// Note that an authoritative source has just confirmed the time
+void TimeService::noteUpdate(long errorUs, long driftErrorPpb)
+{
+        updated = time(nullptr);
+        updateError = errorUs;
+        driftError = driftErrorPpb;
+}
@@ -13,12 +13,36 @@ public:
         // Have we ever heard from a time TimeService
         static bool hasBeenSynced();
 
-        // Do we consider the current time to be unreliable
+        // Do we consider the current time to be unreliable, because its
+        // error bound has grown too wide
         static bool isStale();
 
+        // How far off the clock may be now, in microseconds
+        static long errorBound();
+
         // Return the current localtime as an epoch number
         static time_t localtime();
 
+        // Local time minus UTC at the given moment, in seconds
+        static long utcOffset(time_t t);
+
+        // Find the next daylight saving change: when it happens (UTC epoch)
+        // and how far local time jumps.  Returns false if there is none
+        // in the coming year, or the time is not known yet.
+        static bool nextTransition(time_t & when, long & change);
+
+        // Time until the system clock reaches the next whole second
+        static unsigned long msUntilNextSecond();
+        static unsigned long usUntilNextSecond();
+
         // Set the system time from some authoritative source
         void setTime(time_t epoch);
+
+        // Move the system clock by `us` microseconds.  A nudge is one small
+        // step of a slew, and does not count as the clock being set.
+        static void shiftClock(long long us, bool nudge);
+
+        // Note that an authoritative source has just confirmed the time to
+        // within errorUs, and that the clock may drift by driftErrorPpb
+        static void noteUpdate(long errorUs, long driftErrorPpb);
 };
\ No newline at end of file
@@ -15,6 +15,9 @@
 
 static int realTick = 0;       ///< The number of ticks since we started
 
+static uint32_t lastMicros = 0;  ///< micros() at the last monoNow()
+static uint32_t wraps = 0;       ///< Times micros() has wrapped
+
 //_____________________________________________________________________
 // Increment the tick counter.  This is called once every 100ms by the
 // hardware interrupt or main executive function.
@@ -23,25 +26,30 @@ void ticker() {
 }
 
 //_____________________________________
-// Read the current 10ms tick variable.
-int getTick() {
-  return millis()/100;
+// Read the monotonic clock, counting each wrap of micros() into the
+// upper 32 bits
+Instant monoNow() {
+  uint32_t now = micros();
+  if ( now < lastMicros ) ++wraps;
+  lastMicros = now;
+  return { (uint64_t) wraps << 32 | now };
 }
 
 //_____________________________________
-// Read number of elapsed ticks relative to timer variable
-int elapsed( int timer ) {
-  return getTick() - timer ;
+// Test if a deadline has arrived (is not in the future)
+bool reached( Instant deadline ) {
+  return deadline <= monoNow();
 }
 
 //_____________________________________
-// Return a timer tick from some point in the future
-int getFuture( int nSeconds ) {
-  return getTick() + nSeconds * 10 ;
+// Return the time left until a deadline, or zero if it has passed
+Duration timeUntil( Instant deadline ) {
+  auto left = deadline - monoNow();
+  return left.us > 0 ? left : usecs(0);
 }
 
 //_____________________________________
-// Test if a timer has expired (is in the past)
-bool expired( int timer ) {
-  return elapsed(timer) >= 0;
+// Return milliseconds until a deadline arrives, or 0 if it has passed
+unsigned long msUntil( Instant deadline ) {
+  return ( timeUntil(deadline).us + 999 ) / 1000;
 }
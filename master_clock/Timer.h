@@ -7,6 +7,16 @@
 //    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
 //    By Phil Hord,  This code is in the public domain Sept 9, 2013
 //
+// Monotonic time is kept as 64-bit microseconds since boot, extended
+// from the 32-bit micros() counter that wraps every 71 minutes.  At 64
+// bits it does not wrap for half a million years, so instants compare
+// directly.  Durations are signed and carry their unit in the type, so
+// a millisecond count can not be mistaken for a microsecond one.
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
 
 //________________________________________________________________
 // Tick counter
@@ -18,7 +28,53 @@
 //
 void ticker() ;
 
-int getTick() ;
-int elapsed( int timer ) ;
-int getFuture( int nSeconds ) ;
-bool expired( int timer ) ;
+//________________________________________________________________
+// Durations and instants
+
+// A signed span of time
+struct Duration {
+        int64_t us ;            ///< Microseconds
+} ;
+
+// A point on the monotonic time base; also used as an absolute deadline
+struct Instant {
+        uint64_t us ;           ///< Microseconds since boot.  The low 32 bits are micros().
+} ;
+
+inline constexpr Duration usecs( int64_t n ) { return { n } ; }
+inline constexpr Duration msecs( int64_t n ) { return { n * 1000 } ; }
+inline constexpr Duration secs( int64_t n ) { return { n * 1000000 } ; }
+
+inline constexpr Duration operator+( Duration a , Duration b ) { return { a.us + b.us } ; }
+inline constexpr Duration operator-( Duration a , Duration b ) { return { a.us - b.us } ; }
+inline constexpr bool operator<( Duration a , Duration b ) { return a.us < b.us ; }
+
+inline constexpr Instant operator+( Instant t , Duration d ) { return { t.us + d.us } ; }
+inline constexpr Instant operator-( Instant t , Duration d ) { return { t.us - d.us } ; }
+inline constexpr Duration operator-( Instant a , Instant b ) { return { (int64_t) ( a.us - b.us ) } ; }
+
+// Comparisons go through the signed difference, so they stay right
+// even across a wrap of the 64-bit counter
+inline constexpr bool operator<( Instant a , Instant b ) { return ( a - b ).us < 0 ; }
+inline constexpr bool operator<=( Instant a , Instant b ) { return ( a - b ).us <= 0 ; }
+inline constexpr bool operator>( Instant a , Instant b ) { return b < a ; }
+inline constexpr bool operator>=( Instant a , Instant b ) { return b <= a ; }
+
+//________________________________________________________________
+// Monotonic clock
+
+// The current instant.  Call it from the loop at least once every 71
+// minutes so no wrap of micros() is missed; the scheduler always does.
+Instant monoNow() ;
+
+// True once the deadline has arrived
+bool reached( Instant deadline ) ;
+
+// Time left until the deadline, or zero if it has passed
+Duration timeUntil( Instant deadline ) ;
+
+// Whole milliseconds until the deadline, rounded up, or 0 if it has
+// passed.  Suits a task's return value.
+unsigned long msUntil( Instant deadline ) ;
+
+#endif
@@ -16,62 +16,101 @@
 #include "NtpServer.h"
 #include "TimeSave.h"
 #include "TimeService.h"
+#include "PulseSchedule.h"
+#include "PulseTimer.h"
+#include "PulseStats.h"
+#include "CatchUp.h"
+#include "Config.h"
+#include "Protocol.h"
+#include "Inputs.h"
+#include "Metrics.h"
+#include "Profiler.h"
 
 //_____________________________________________________________________
 //                                                           LOCAL VARS
 
-static unsigned walltime ;     ///< Current hours/minutes displayed on clock
-int a = LOW , b = LOW ;        ///< Desired A and B signal levels
-int d = LOW ;                  ///< Desired D signal level
-int aForce = 0 ;               ///< Force A pulse by operator control
-int bForce = 0 ;               ///< Force B pulse by operator control
+// Protocol state of one slave-clock circuit
+struct Channel {
+        unsigned walltime ;    ///< Current hours/minutes displayed on clock
+        bool haveWallTime ;    ///< walltime is known to match the face
+        unsigned signals[MAX_BURST] ;  ///< SIGNAL_* bits of each pulse this second
+        unsigned burst ;       ///< Catch-up pulses to send this second
+        unsigned shown ;       ///< Signals raised by the last rising edge
+        bool running ;         ///< Pulsing every second to catch up
+        bool runHeld ;         ///< RUN was held for the last second decided
+        CatchUpPlan plan ;     ///< Latest catch-up plan
+        unsigned prev_t ;      ///< Last second decided
+        long behind ;          ///< Seconds real time was ahead of the face then
+
+        unsigned long pulses[LINES_PER_CHANNEL] ;  ///< Rising edges on A, B and D
+        unsigned long runMinutes ;     ///< Minutes stepped by catch-up pulses
+        unsigned long waitSeconds ;    ///< Seconds spent waiting for real time
+        unsigned corrections ;         ///< Catch-up runs and waits started
+        unsigned long lateWorst ;      ///< Latest rising edge, in microseconds
+} ;
 
-typedef enum State {
-	reset ,                // Reset ticker to 0 to sync with exact second
-	rise ,                 // Rising edge of pulse
-	riseWait ,             // Wait for pulse-rise time
-	fall ,                 // Falling edge of pulse
-	fallWait ,             // Wait for pulse-fall time
-} State ;
+static Channel channels[NUM_CHANNELS] ;
 
-State state = rise ;           ///< Protocol chain state tracker.
+// Face minutes stepped by one queued pulse, per channel.  A pulse may
+// still be on its way to the movement when the power fails, so the last
+// two are kept until the timer has surely finished with them.
+struct SentPulse {
+        unsigned ticket ;               ///< From queuePulse(), 0 if none
+        unsigned steps[NUM_CHANNELS] ;  ///< Minutes walltime moved for it
+} ;
+static SentPulse sent[2] ;             ///< [0] is the newest
+
+// Power-fail save timing
+static unsigned long powerSaves = 0 ;      ///< Power failures saved for
+static unsigned long powerSaveLast = 0 ;   ///< Microseconds from edge to saved
+static unsigned long powerSaveWorst = 0 ;
+static unsigned long powerSaveOver = 0 ;   ///< Saves that missed the budget
+int aForce = 0 ;               ///< Force A pulse by operator control
+int bForce = 0 ;               ///< Force B pulse by operator control
 
 //_____________________________________________________________________
 //                                                            CONSTANTS
 
-// Signal output duration, in 10ms ticks
-enum {
-	riseTime = 6 ,     // 600ms rise time
-	fallTime = 4 ,     // 400ms fall time
-} ;
+// Signal output duration.  Pulses rise on the second, so the fall time
+// is whatever is left of the second after the rise.
+static constexpr Duration riseTime = msecs(ClockProtocol::Policy::riseMs) ;
+static constexpr Duration fallTime = msecs(ClockProtocol::Policy::fallMs) ;
+static_assert( (riseTime + fallTime).us == secs(1).us , "pulse must fit in one second" ) ;
+
+// Time from the power-fail edge to the face position reaching flash.
+// The supply holds up for a few tens of milliseconds at best.
+#define POWER_SAVE_BUDGET_US  20000
 
 //_____________________________________________________________________
 // Time accessors
 // Let other functions get and set the clock time
 
+// Shift a master time of day into the channel's zone
+static unsigned shiftTime(unsigned t, int channel) {
+        return (MAX_TIME + t + channelShift(channel) % MAX_TIME) % MAX_TIME;
+}
+
+// Local time of day on the 12-hour dial, before any channel's shift
+static unsigned masterTime() {
+        return TimeService::localtime() % MAX_TIME;
+}
+
 // Get real time from system in seconds
-int getRealTime() {
-        time_t now = TimeService::localtime();
-        return now % MAX_TIME;
+int getRealTime(int channel) {
+        return shiftTime(masterTime(), channel);
 }
 
 // Get time displayed on clock in seconds
-int getWallTime() { return walltime * 60; }
+int getWallTime(int channel) { return channels[channel].walltime * 60; }
 
 // Set time displayed on clock in seconds
-void setWallTime(int seconds) {
-        walltime = (seconds % MAX_TIME) / 60;
-}
-
-// Advance the time on the wall display clock
-void incMinutes() {
-        walltime++;
-        walltime %= MAX_TIME / 60;
+static void setWallTime(Channel & ch, int seconds) {
+        ch.walltime = (seconds % MAX_TIME) / 60;
 }
 
 // Set time displayed on clock to real time
-void resetWallTime() {
-        setWallTime(TimeService::localtime());
+static void resetWallTime(int channel) {
+        setWallTime(channels[channel], getRealTime(channel));
 }
 
 //_____________________________________________________________________
@@ -81,41 +120,27 @@ void resetWallTime() {
 void sendPulseA() { ++aForce ; }
 void sendPulseB() { ++bForce ; }
 
-bool getA() { return a ; }        // Read the last A-signal level
-bool getB() { return b ; }        // Read the last B-signal level
-bool getD() { return d ; }        // Read the last D-signal level
+bool getA(int channel) { return channels[channel].shown & SIGNAL_A ; }        // Read the last A-signal level
+bool getB(int channel) { return channels[channel].shown & SIGNAL_B ; }        // Read the last B-signal level
+bool getD(int channel) { return channels[channel].shown & SIGNAL_D ; }        // Read the last D-signal level
 
 //_____________________________________________________________________
 //                                                        TIME PROTOCOL
 //
-// These functions actually implement the time protocol.
+// These functions actually implement the time protocol.  Which one is
+// chosen at build time with CLOCK_PROTOCOL; its rules are in Protocol.h
+// and its schedule table in PulseSchedule.cpp.
 
 //_____________________________________
 // Implement the A-signal protocol.
 // Returns HIGH or LOW depending on what the A-signal output should
 // based on the current time.
 //
-// The 'A' signal is raised once per minute at zero-seconds, and on
-// every odd second between 10 and 50 during the 59th minute.
-//
-// Note: If 'aForce' is non-zero or pin D2 is high, return HIGH.
+// With the IBM protocol, the 'A' signal is raised once per minute at
+// zero-seconds, and on every even second between 10 and 50 during the
+// 59th minute.
 int checkA(unsigned t) {
-    // Manual run based on serial input
-    if ( aForce ) { aForce-- ; return HIGH ; }
-
-    unsigned int s = t % 60;
-    unsigned int m = (t / 60) % 60;
-
-    // pulse once per minute
-    if ( s == 0 ) return HIGH ;
-
-    if ( m == 59 ) {
-      if ( s >= 10 && s <= 50 ) {
-        // On even seconds from 10 to 50, pulse A
-        if ( ( s & 1 ) == 0 ) return HIGH ;
-      }
-    }
-    return LOW ;
+    return ( pulseSignals(t) & SIGNAL_A ) ? HIGH : LOW ;
 }
 
 //_____________________________________
@@ -123,22 +148,10 @@ int checkA(unsigned t) {
 // Returns HIGH or LOW depending on what the B-signal output should
 // based on the current time.
 //
-// The 'B' signal is raised once per minute at zero-seconds for each
-// minute except for minutes 50 to 59.
-//
-// Note: If 'bForce' is non-zero, return HIGH.
+// With the IBM protocol, the 'B' signal is raised once per minute at
+// zero-seconds for each minute except for minutes 50 to 59.
 int checkB(unsigned t) {
-    // Manual run based on serial input
-    if ( bForce ) { bForce-- ; return HIGH ; }
-
-    unsigned int s = t % 60;
-    unsigned int m = (t / 60) % 60;
-
-    // pulse once per minute from 00 to 49
-    if ( m > 49 ) return LOW ;
-
-    if ( s == 0 ) return HIGH ;
-    return LOW ;
+    return ( pulseSignals(t) & SIGNAL_B ) ? HIGH : LOW ;
 }
 
 //_____________________________________
@@ -146,15 +159,25 @@ int checkB(unsigned t) {
 // Returns HIGH or LOW depending on what the D-signal output should
 // based on the current time.
 //
-// The 'D' signal is raised once per minute at zero-seconds for each
-// minute.
+// With the IBM protocol, the 'D' signal is raised once per minute at
+// zero-seconds for each minute.
 int checkD(unsigned t) {
-    unsigned int s = t % 60;
+    return ( pulseSignals(t) & SIGNAL_D ) ? HIGH : LOW ;
+}
 
-    // pulse once per minute
+// Signals the operator forced for the coming second, on every channel.
+// Manual run based on serial input.
+static unsigned takeForced() {
+    unsigned forced = 0 ;
+    if ( aForce ) { aForce-- ; forced |= SIGNAL_A ; }
+    if ( bForce ) { bForce-- ; forced |= SIGNAL_B ; }
+    return forced ;
+}
 
-    if ( s == 0 ) return HIGH ;
-    return LOW ;
+// Protocol signals for second t, as the check functions decide them,
+// in one schedule lookup
+static unsigned protocolSignals(unsigned t) {
+    return pulseSignals(t) ;
 }
 
 // Flicker the LED if something interesting has happened
@@ -165,13 +188,16 @@ void showActivity(int count) {
     somethingHappened = count*2 + 1;
 }
 
-static void ledService() {
-  static int subTimer = 0;       ///< State counter per 100ms
-  if (!subTimer) subTimer = getTick();
+// LED step: 1s while idle, 100ms while flickering
+static Duration ledStep() {
+  return msecs((somethingHappened == 1) ? 1000 : 100);
+}
+
+unsigned long ledService() {
+  static Instant subTimer = monoNow();   ///< Time of the last LED step
 
-  int ledTime = (somethingHappened == 1) ? 10 : 1;
-  if (elapsed(subTimer) < ledTime ) return ;
-  subTimer += ledTime;
+  if (!reached(subTimer + ledStep())) return msUntil(subTimer + ledStep()) ;
+  subTimer = subTimer + ledStep();
 
   if (somethingHappened) {
     if (--somethingHappened)
@@ -179,125 +205,434 @@ static void ledService() {
   }
 
   digitalWrite(BUILTIN_LED, led ? LOW : HIGH);
+
+  return msUntil(subTimer + ledStep()) ;
 }
 
 void toggleLed() {
   led = !led;
 }
 
-// The time difference when we're 30 minutes fast
-#define FAST_WAIT_THRESHOLD     (MAX_TIME - 30*60)
+//_____________________________________
+// Set the face position when the RUN switch is let go.  The operator
+// lets go once the face shows the right time, so it showed the minute
+// of the release edge; each RUN pulse that rose after the edge, already
+// queued by then, stepped it once more.
+static void releaseRun(Channel & ch, unsigned now) {
+        // `now` starts usUntilNextSecond() from here
+        unsigned back = (TimeService::usUntilNextSecond() + (micros() - runChangedAt())) / 1000000 + 1;
+        unsigned seen = (MAX_TIME + now - back) % MAX_TIME;
+        ch.walltime = (seen / 60 + back - 1) % (MAX_TIME / 60);
+}
 
-bool haveWallTime = false;
 //_____________________________________
 // Advances second and minute counters.
-void markTime()
+// Decides the A/B/D signals of one channel for the given second of
+// its real time.  `forced` holds the operator's forced signals.
+static void markTime(int c, unsigned now, unsigned forced)
 {
-        static unsigned prev_t = 0;
-        auto now = getRealTime();
-        auto display = getWallTime() + 60;
-        auto delta = (MAX_TIME + now - display) % MAX_TIME;
+        Channel & ch = channels[c];
+        ch.signals[0] = 0;
+        ch.burst = 0;
 
-        a = b = d = LOW;
+        if (ch.prev_t == now) return;
+        ch.prev_t = now;
 
-        if (prev_t == now) return;
-        prev_t = now;
+        bool run = run_switch();
+        if (ch.runHeld && !run) {
+                releaseRun(ch, now);
+                ch.haveWallTime = true;
+        }
+        ch.runHeld = run;
+
+        auto display = getWallTime(c) + 60;
+        auto delta = (MAX_TIME + now - display) % MAX_TIME;
+        ch.behind = (delta > MAX_TIME / 2 ? delta - MAX_TIME : delta) + 60;
 
-        if (!haveWallTime || !TimeService::hasBeenSynced()) {
+        if (!ch.haveWallTime || !TimeService::hasBeenSynced()) {
                 // If we don't know the clock position, we can't catch up
                 delta = 0;
         }
 
-        if (run_switch()) {
-                // p(":RUN:");
-                a = b = d = HIGH;
-                resetWallTime();
-                haveWallTime = true;
+        auto wasCorrecting = ch.plan.wait || ch.plan.ride || ch.plan.pulses;
+        ch.plan = delta ? planCatchUp(ch.walltime, now) : planCatchUp(0);
+        if (!wasCorrecting && (ch.plan.wait || ch.plan.ride || ch.plan.pulses)) {
+                ++ch.corrections;
+                p("\nCorrecting %d: %s, about %lus\n", c,
+                  ch.plan.wait ? "wait" : ch.plan.ride ? "ride" : "run", ch.plan.seconds);
         }
-        else if (delta > FAST_WAIT_THRESHOLD) {
-                // Clock is fast, but it's less than 30 minutes fast.  Let's just wait for time to catch up
-                // p(":FAST %ld:", MAX_TIME-delta, MAX_TIME-FAST_WAIT_THRESHOLD);
 
-        } else if (delta > 60) {
-                // Clock is 2+ minutes slow. Run until we catch up.
+        ch.running = false;
+        if (run) {
+                // p(":RUN:");
+                // Step the face a minute a second, each pulse decided for
+                // where the one before left it
+                ch.running = true;
+                ch.signals[0] = ClockProtocol::Policy::run(ch.walltime);
+                ch.walltime = ClockProtocol::stepFace(ch.walltime, ch.signals[0]);
+        }
+        else if (ch.plan.wait) {
+                // Clock is fast, and waiting for time to catch up is quicker than running around
+                // p(":FAST %ld:", MAX_TIME-delta);
+                ++ch.waitSeconds;
+
+                // Keep the schedule going for any other movements on the
+                // line where the protocol allows it, as with an IBM face
+                // parked at :59 late in the hour.
+                ch.signals[0] = ClockProtocol::waitSignals(ch.walltime, now, protocolSignals(now) | forced);
+                ch.walltime = ClockProtocol::stepFace(ch.walltime, ch.signals[0]);
+
+        } else if (ch.plan.ride) {
+                // Clock is slow, and the schedule's own correction brings
+                // it right this minute.  Send only the schedule, plus what
+                // movements without the correction need.
+                ch.signals[0] = ClockProtocol::rideSignals(ch.walltime, protocolSignals(now) | forced);
+                ch.walltime = ClockProtocol::stepFace(ch.walltime, ch.signals[0]);
+
+        } else if (ch.plan.pulses) {
+                // Clock is slow. Run until we catch up.
                 // p(":SLOW %ld:", delta);
-                a = b = d = HIGH;
-                incMinutes();
+                // Only raise the lines the cam needs for the minutes we step through
+                ch.running = true;
+                // setPulseTiming() keeps a burst well under MAX_BURST
+                ch.burst = ch.plan.pulses < MAX_BURST ? ch.plan.pulses : MAX_BURST;
+                ch.runMinutes += ch.burst;
+                ch.walltime = ClockProtocol::catchUpBurst(ch.walltime, ch.burst, ch.signals);
         } else {
                 // p(":ONTIME %ld:", delta);
-                a = checkA(now) ;
-                b = checkB(now) ;
-                d = checkD(now) ;
-                if ((now % 60) == 0) incMinutes();
+                ch.signals[0] = protocolSignals(now) | forced;
+
+                // Step the face the way the movement will, including the
+                // minute 59 correction burst that a correct face ignores
+                ch.walltime = ClockProtocol::stepFace(ch.walltime, ch.signals[0]);
         }
 
         // Once we know and saved the real time, assume we're in sync
-        if (!haveWallTime && TimeService::hasBeenSynced()) {
-                haveWallTime = saveTime();
-                if (haveWallTime) resetWallTime();
+        if (!ch.haveWallTime && TimeService::hasBeenSynced()) {
+                ch.haveWallTime = saveTime(c);
+                if (ch.haveWallTime) resetWallTime(c);
         }
 
 }
 
+//_____________________________________
+// Daylight saving changes
+//
+// A DST change moves real time an hour at once, and the correction that
+// follows takes as long as the planner says.  Rather than starting it
+// when the hour jumps, we start half of that time early by treating the
+// change as already made.  The clock is then wrong for the same time,
+// but it is never more than about half the change away from right, and
+// the wrong window is centred on the change instead of following it.
+
+// Seconds the correction for a DST change of `change` seconds will take
+static unsigned long dstCorrection(long change) {
+        return planCatchUp((MAX_TIME + change % MAX_TIME + 30) % MAX_TIME).seconds;
+}
+
+// Real time as markTime() should see it `ahead` seconds from now, when
+// the master time will be `t`.  service() decides each second with this,
+// and pulseQuiet() looks ahead with it, so a save window never overlaps
+// an early DST correction.
+static unsigned plannedTime(int c, unsigned t, unsigned ahead) {
+        t = shiftTime(t, c);
+        time_t when;
+        long change;
+        if (!channels[c].haveWallTime || !TimeService::nextTransition(when, change)) return t;
+
+        long until = (long) (when - time(nullptr)) - ahead;
+        if (until > 0 && (unsigned long) until <= dstCorrection(change) / 2)
+                return (MAX_TIME + t + change % MAX_TIME) % MAX_TIME;
+        return t;
+}
+
+// Report the next DST change and how long the clock will be wrong for it
+void showDst() {
+        time_t when;
+        long change;
+        if (!TimeService::nextTransition(when, change)) {
+                p("\nNo DST change ahead\n");
+                return;
+        }
+        auto local = when + TimeService::utcOffset(when);
+        auto tm = *gmtime(&local);
+        auto wrong = dstCorrection(change);
+        p("\nNext DST change: %04d-%02d-%02d %02d:%02d, %+ld min\n",
+          tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, change / 60);
+        p("Clock wrong for about %lus, starting %lus early\n", wrong, wrong / 2);
+}
+
+//_____________________________________
+// True if no pulse is on the lines or due within the next `seconds`
+bool pulseQuiet(unsigned seconds) {
+        if (pulseHigh()) return false;
+        if (!seconds) return true;
+        if (pulseBusy()) return false;
+        unsigned now = masterTime();
+        for (int c = 0; c < NUM_CHANNELS; c++) {
+                if (channels[c].running) return false;
+                unsigned next = plannedTime(c, (now + 1) % MAX_TIME, 1);
+                if (secondsUntilNextPulse(next) < seconds) return false;
+
+                // A DST correction that starts inside the window runs
+                // pulses the schedule doesn't show
+                unsigned last = plannedTime(c, (now + seconds) % MAX_TIME, seconds);
+                if (last != (next + seconds - 1) % MAX_TIME) return false;
+        }
+        return true;
+}
+
+//_____________________________________
+// Report the catch-up plan on the console
+void showCatchUp() {
+        p("\n");
+        for (int c = 0; c < NUM_CHANNELS; c++) {
+                auto & plan = channels[c].plan;
+                if (plan.wait) p("%d: Waiting for real time, about %lus\n", c, plan.seconds);
+                else if (plan.ride) p("%d: Riding the schedule's correction, about %lus\n", c, plan.seconds);
+                else if (plan.pulses) p("%d: Running %u/s to catch up, about %lus\n", c, pulsesPerSecond(), plan.seconds);
+                else p("%d: On time\n", c);
+        }
+}
+
+//_____________________________________
+// Report each channel's face, pulses and timing on the console
+void showChannels() {
+        p("\n");
+        for (int c = 0; c < NUM_CHANNELS; c++) {
+                auto & ch = channels[c];
+                p("%d: face %02u:%02u%s, %+ld min from local time\n",
+                  c, ch.walltime / 60, ch.walltime % 60, ch.haveWallTime ? "" : "?", channelShift(c) / 60);
+                p("   pulses A %lu, B %lu, D %lu\n", ch.pulses[0], ch.pulses[1], ch.pulses[2]);
+                p("   %u corrections, %lu min run, %lus waited, latest rise %luus\n",
+                  ch.corrections, ch.runMinutes, ch.waitSeconds, ch.lateWorst);
+        }
+}
+
 void clockSetup() {
-        auto t = readTime();
-        if (t>=0) {
-                haveWallTime = true;
-                setWallTime(t);
-                t /= 60;
-                p("Clock face: %02d:%02d\n", t/60, t%60);
+        configSetup();
+        p("%s protocol\n", ClockProtocol::Policy::name);
+        for (int c = 0; c < NUM_CHANNELS; c++) {
+                auto t = readTime(c);
+                if (t>=0) {
+                        channels[c].haveWallTime = true;
+                        setWallTime(channels[c], t);
+                        t /= 60;
+                        p("Clock face %d: %02d:%02d\n", c, t/60, t%60);
+                }
         }
 }
 
 //_____________________________________
-// the service routine runs over and over again forever:
-void service() {
-  static int subTimer = 0;       ///< State counter per 100ms
-
-  consoleService() ;
-  NtpService() ;
-  ledService();
-
-  switch (state) {
-  default:
-  case reset:
-    subTimer = getTick() ;
-  case rise:
-    markTime();
-
-    if (a||b||d) {
-        sendSignal( a , b , d ) ;        // Send output pulses (if any)
-        toggleLed();
-        subTimer = getTick();
-        state = riseWait;
+// Note a rising edge on the channels whose lines it raised
+static void channelRise(const PulseEdge & edge) {
+  long late = (long) (edge.micros - edge.due);
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    auto & ch = channels[c];
+    ch.shown = (edge.lines >> (LINES_PER_CHANNEL * c)) & SIGNAL_ALL;
+    if (!ch.shown) continue;
+    for (int s = 0; s < LINES_PER_CHANNEL; s++)
+      if (ch.shown & (1 << s)) ++ch.pulses[s];
+    if (late > 0 && (unsigned long) late > ch.lateWorst) ch.lateWorst = late;
+  }
+}
+
+//_____________________________________
+// the service routine runs over and over again forever.
+// Returns milliseconds until the next protocol step is due.
+//
+// The pulse edges themselves are driven by the pulse timer.  Each pass
+// reports the edges it emitted since last time, and queues the pulse for
+// the coming second.  We wake a little after each second boundary so the
+// rising edge has already been sent when we report it.
+//
+// Every channel's lines go out together.  When any channel is running
+// to catch up, the whole second uses the catch-up pulse timing, and the
+// channels that are on time get their single pulse as the first of the
+// burst.
+unsigned long service() {
+  static int queuedFor = -1;     ///< Second whose pulse has been decided
+
+  PulseEdge edge;
+  while (readPulseEdge(edge)) {
+    recordPulseEdge(edge);
+    toggleLed();
+    if (edge.lines) {
+      channelRise(edge);
+    } else {
+      showSignalDrop() ;
+
+      // Save new clock time, if it has changed
+      for (int c = 0; c < NUM_CHANNELS; c++) {
+        channels[c].shown = 0;
+        PROFILE("saveTime");
+        saveTime(c);
+      }
     }
-    showTime() ;                 // Report time and signals to serial port
+  }
 
-    break ;
+  {
+    PROFILE("showTime");
+    showTime() ;               // Report time and signals to serial port
+  }
 
-  case riseWait:
-    if ( elapsed(subTimer) < riseTime ) break ;
-    subTimer = getTick();
-    state = fall;
-    break;
+  // Decide the next second only once the timer has taken the last pulse.
+  // The face doesn't move while the pulses are held for a power failure.
+  int next = (masterTime() + 1) % MAX_TIME;
+  if (next != queuedFor && !pulsePending() && !pulseHeld()) {
+    unsigned forced = takeForced();
+    unsigned lines[MAX_BURST] = {};
+    unsigned count = 0;
+    bool burst = false;
+    unsigned before[NUM_CHANNELS];
+
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+      auto & ch = channels[c];
+      before[c] = ch.walltime;
+      {
+        PROFILE("markTime");
+        markTime(c, plannedTime(c, next, 1), forced);
+      }
+      if (!ch.signals[0]) continue;
 
-  case fall:
-    sendSignal( LOW , LOW , LOW ) ;     // End output pulses
-    subTimer = getTick();
-    toggleLed();
-    showSignalDrop() ;
+      unsigned n = ch.burst ? ch.burst : 1;
+      for (unsigned i = 0; i < n; i++) lines[i] |= CHANNEL_LINES(c, ch.signals[i]);
+      if (n > count) count = n;
+      burst |= ch.burst > 0;
+    }
+
+    // The pulse timer works in micros(), the low half of an Instant
+    auto riseAt = monoNow() + usecs(TimeService::usUntilNextSecond());
+    auto & config = getConfig();
+    auto width = burst ? msecs(config.riseMs) : riseTime;
+    auto period = msecs(config.riseMs + config.fallMs);
+    if (count) {
+      auto ticket = queuePulse(lines, (unsigned long) riseAt.us, width.us, count, period.us);
+      if (ticket) {
+        sent[1] = sent[0];
+        sent[0].ticket = ticket;
+        for (int c = 0; c < NUM_CHANNELS; c++)
+          sent[0].steps[c] = (MAX_TIME / 60 + channels[c].walltime - before[c]) % (MAX_TIME / 60);
+      } else {
+        // Held since we looked; these steps will never reach the face
+        for (int c = 0; c < NUM_CHANNELS; c++) channels[c].walltime = before[c];
+      }
+    }
+    queuedFor = next;
+  }
 
-    state = fallWait;
-    break;
+  return TimeService::msUntilNextSecond() + 50;
+}
 
-  case fallWait:
-    if ( elapsed(subTimer) < fallTime ) break ;
-    subTimer += fallTime ;
+//_____________________________________
+// Wind walltime back over the steps the held pulses never delivered,
+// then write every face position straight to RTC memory and flash.
+static bool commitFaces() {
+  unsigned ticket, delivered;
+  pulseHoldProgress(ticket, delivered);
+
+  bool saved = true;
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    auto & ch = channels[c];
+    unsigned lost = 0;
+    for (auto & s : sent) {
+      if (!s.ticket) continue;
+      if ((int) (s.ticket - ticket) > 0) lost += s.steps[c];
+      else if (s.ticket == ticket && s.steps[c] > delivered) lost += s.steps[c] - delivered;
+    }
+    ch.walltime = (MAX_TIME / 60 + ch.walltime - lost % (MAX_TIME / 60)) % (MAX_TIME / 60);
+    if (ch.haveWallTime) saved &= commitTime(c, getWallTime(c));
+  }
+  sent[0] = sent[1] = SentPulse();
+  return saved;
+}
 
-    // Save new clock time, if it has changed
-    saveTime();
+//_____________________________________
+// Save the face positions when the power-fail input trips.
+// Returns milliseconds until it next needs to run.
+//
+// The input's interrupt holds the pulse timer and wakes this task; flash
+// can't be written from the interrupt itself.  Once the supply has been
+// back and steady for a while, the pulses are released and the catch-up
+// planner makes up the minutes the face missed.  With no input wired this
+// never saves; saveService() keeps the journal a minute behind instead.
+unsigned long powerService() {
+  static unsigned handled = 0;   ///< powerFailCount() already saved for
+
+  if (powerFailCount() != handled) {
+    handled = powerFailCount();
+    bool saved = commitFaces();
+    powerSaveLast = micros() - powerFailAt();
+    if (powerSaveLast > powerSaveWorst) powerSaveWorst = powerSaveLast;
+    ++powerSaves;
+    if (powerSaveLast > POWER_SAVE_BUDGET_US) ++powerSaveOver;
+    if (!saved) plog(LOG_ERROR, "Power fail: face position not saved\n");
+    else if (powerSaveLast > POWER_SAVE_BUDGET_US)
+      plog(LOG_ERROR, "Power fail: save took %luus\n", powerSaveLast);
+  }
+
+  if (!pulseHeld()) return 1000;
+  if (powerFailed()) return 1000;
+  auto settle = powerSettling();
+  if (settle) return settle;
+
+  pulseRelease();
+  p("\nPower back, face at %02u:%02u\n", channels[0].walltime / 60, channels[0].walltime % 60);
+  return 1000;
+}
 
-    state = rise;
-    break;
+//_____________________________________
+// Report power-fail saves on the console
+void showPowerStats() {
+  p("Power fail saves %lu, last %luus, worst %luus, %lu over %dus\n",
+    powerSaves, powerSaveLast, powerSaveWorst, powerSaveOver, POWER_SAVE_BUDGET_US);
+}
+
+//_____________________________________
+// Write each channel's pulses and timing, and the power-fail saves
+void writeClockMetrics(MetricsBuffer & m) {
+  static const char names[] = "ABD";
+  char labels[32];
+
+  m.family("clock_pulses_total", "counter", "Rising edges sent on each signal line");
+  for (int c = 0; c < NUM_CHANNELS; c++)
+    for (int s = 0; s < LINES_PER_CHANNEL; s++) {
+      snprintf(labels, sizeof labels, "channel=\"%d\",signal=\"%c\"", c, names[s]);
+      m.sample("clock_pulses_total", channels[c].pulses[s], labels);
+    }
+
+  m.family("clock_catchup_minutes_total", "counter", "Face minutes stepped by catch-up pulses");
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    snprintf(labels, sizeof labels, "channel=\"%d\"", c);
+    m.sample("clock_catchup_minutes_total", channels[c].runMinutes, labels);
   }
+  m.family("clock_wait_seconds_total", "counter", "Seconds spent waiting for real time to catch up");
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    snprintf(labels, sizeof labels, "channel=\"%d\"", c);
+    m.sample("clock_wait_seconds_total", channels[c].waitSeconds, labels);
+  }
+  m.family("clock_corrections_total", "counter", "Catch-up runs and waits started");
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    snprintf(labels, sizeof labels, "channel=\"%d\"", c);
+    m.sample("clock_corrections_total", channels[c].corrections, labels);
+  }
+  m.family("clock_face_behind_seconds", "gauge", "Real time minus face time; 0 to 59 when on time");
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    snprintf(labels, sizeof labels, "channel=\"%d\"", c);
+    m.sample("clock_face_behind_seconds", channels[c].behind, labels);
+  }
+  m.family("clock_face_known", "gauge", "1 if the face position is known");
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    snprintf(labels, sizeof labels, "channel=\"%d\"", c);
+    m.sample("clock_face_known", channels[c].haveWallTime, labels);
+  }
+  m.family("clock_pulse_late_worst_microseconds", "gauge", "Latest rising edge after its second");
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    snprintf(labels, sizeof labels, "channel=\"%d\"", c);
+    m.sample("clock_pulse_late_worst_microseconds", channels[c].lateWorst, labels);
+  }
+
+  m.counter("clock_power_fail_saves_total", "Face positions saved on power failure", powerSaves);
+  m.gauge("clock_power_save_microseconds", "Last power-fail edge to saved", powerSaveLast);
+  m.gauge("clock_power_save_worst_microseconds", "Worst power-fail edge to saved", powerSaveWorst);
 }
@@ -13,6 +13,9 @@
 // implementation for the Arduino, and there is another
 // implementation for the PC.
 
+#ifndef CLOCK_GENERIC_H
+#define CLOCK_GENERIC_H
+
 //________________________________________________________________
 // Tick counter
 //
@@ -34,17 +37,37 @@ void ticker() ;
 void sendString( const char * str ) ;
 char readKey();
 
+//________________________________________________________________
+// Channels
+//
+// One master can drive several independent slave-clock circuits.
+// Each channel has its own A, B and D lines, its own face position
+// and catch-up state, and may show a different time zone.  The number
+// of channels is set here or with -DNUM_CHANNELS; the main program
+// gives their pins and zones.
+
+#ifndef NUM_CHANNELS
+#define NUM_CHANNELS 1
+#endif
+
+// Bit for each signal line of each channel: the SIGNAL_* bits of
+// channel c, shifted up by three bits per channel
+#define LINES_PER_CHANNEL 3
+#define CHANNEL_LINES( c , signals ) ( (unsigned) (signals) << ( LINES_PER_CHANNEL * (c) ) )
+
+// Seconds the channel's face is ahead of the master time zone.  Zones
+// are fixed offsets from MYTZ, so all channels change for DST together.
+long channelShift( int channel ) ;
+
 //________________________________________________________________
 // Raise/lower digital IO pins
 //
-// The time protocol uses two signal lines, A and B.  These
-// variables hold the desired state of these two lines.  To
-// raise a signal line, set the corresponding variable to 1.
-// To lower the signal line, set the corresponding variable
-// to 0.  Call the function sendSignal to actually raise or
-// lower each signal line.
+// The time protocol uses signal lines A, B and D on every channel.
+// Call sendLines with the CHANNEL_LINES() bits to raise; every other
+// line is lowered.  All lines change in as few GPIO writes as the
+// hardware allows.  This is called from the pulse timer interrupt.
 
-void sendSignal( int a, int b, int d) ;
+void sendLines( unsigned lines ) ;
 
 int run_switch() ;
 
@@ -54,19 +77,44 @@ int run_switch() ;
 // We want to run all the time, but we do not "own" the whole
 // process.  The main process calls this routine repeatedly
 // as long as our program is running.  This is where we do
-// all the "work" of the program.
+// all the "work" of the program.  It returns the number of
+// milliseconds until it next has something to do, so the
+// scheduler can sleep in between.
 
-void service() ;
+unsigned long service() ;
 void clockSetup();
 
+// Saves the face positions when the power fails, and releases the
+// pulses once it is back.  Woken by the power-fail interrupt.
+unsigned long powerService() ;
+
+// Report power-fail save timing on the console
+void showPowerStats() ;
+
+// Write per-channel pulse counts, face offset and power-fail saves
+class MetricsBuffer ;
+void writeClockMetrics( MetricsBuffer & m ) ;
+
 //________________________________________________________________
 // Time accessors
 // Let other functions get and set the clock time
 
 #define MAX_TIME (12*60*60)
 
-int getWallTime() ;
-int getRealTime() ;
+int getWallTime( int channel = 0 ) ;
+int getRealTime( int channel = 0 ) ;
+
+// True if no pulse is on the lines or due within the next `seconds`
+bool pulseQuiet(unsigned seconds) ;
+
+// Report the catch-up plan on the console
+void showCatchUp() ;
+
+// Report per-channel face, pulse counts and timing on the console
+void showChannels() ;
+
+// Report the next DST change on the console
+void showDst() ;
 
 //_____________________________________________________________________
 // Signal accessors
@@ -75,9 +123,9 @@ int getRealTime() ;
 void sendPulseA() ;
 void sendPulseB() ;
 
-bool getA() ;        // Read the last A-signal level
-bool getB() ;        // Read the last B-signal level
-bool getD() ;        // Read the last D-signal level
+bool getA( int channel = 0 ) ;        // Read the last A-signal level
+bool getB( int channel = 0 ) ;        // Read the last B-signal level
+bool getD( int channel = 0 ) ;        // Read the last D-signal level
 
 // LED service: LED usually tracks clock signal lines, but it flickers at 5Hz
 // to show other activity (network messages, time sync loss, etc.)
@@ -87,3 +135,8 @@ void syncActivity(bool state);
 
 // Sync call to show something happened that needs flickering `count` times
 void showActivity(int count);
+
+// Update the LED; returns milliseconds until the next update
+unsigned long ledService();
+
+#endif
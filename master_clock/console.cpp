@@ -15,17 +15,174 @@
 #include <stdarg.h>
 #include "clock_generic.h"
 #include "console.h"
+#include "Scheduler.h"
+#include "PulseStats.h"
+#include "TimeSave.h"
+#include "TelnetServer.h"
+#include "SpscRing.h"
+#include "Config.h"
+#include "OutputStage.h"
+#include "NtpClient.h"
+#include "NtpServer.h"
+#include "Inputs.h"
+#include "MetricsServer.h"
+#include "Profiler.h"
+#include "Network.h"
 
 //_____________________________________________________________________
-// Print formatted text to the console.
+// Log sink
+//
+// p() does not format anything.  It copies the format pointer and the
+// raw arguments into a fixed ring and returns.  logService() formats the
+// entries later, outside the pulse path, and feeds them to the serial
+// port and telnet only as fast as they will take them.  When the ring is
+// full the message is dropped and counted.
+//
+// Since formatting happens later, %s arguments must stay valid until
+// then; in practice they are string literals.  Integers may be up to
+// long long.  Floating point conversions are not supported.
+
+#define LOG_ARGS        6       // Most arguments one message can carry
+#define LOG_LINE        128     // Formatted messages are cut at this length
+
+union LogArg {
+        long long i;
+        const char * s;
+};
+
+struct LogEntry {
+        const char * fmt;
+        LogArg args[LOG_ARGS];
+};
+
+static SpscRing<LogEntry, 64> logRing;
+
+static char logLine[LOG_LINE];  ///< Message being written to the sinks
+static int serialPos = 0;       ///< Bytes of logLine the serial port has taken
+static int telnetPos = 0;       ///< Bytes of logLine telnet has taken
+static int logLen = 0;
+
+//_____________________________________
+// Skip over the flags, width, precision and length of a conversion.
+// Returns a pointer to the conversion character and sets longs to 0
+// for int, 1 for long and 2 for long long.
+static const char * skipSpec(const char * f, int & longs) {
+        longs = 0;
+        while (*f && strchr("-+ #0123456789.", *f)) f++;
+        while (*f == 'l' || *f == 'h' || *f == 'z') {
+                if (*f != 'h' && longs < 2) longs++;
+                f++;
+        }
+        return f;
+}
+
+//_____________________________________
+// Queue formatted text for the console.
 void p(const char *fmt, ... ){
-        char tmp[128]; // resulting string limited to 128 chars
-        memset(tmp,0,sizeof(tmp));
+        LogEntry entry;
+        entry.fmt = fmt;
+
         va_list args;
         va_start (args, fmt );
-        vsnprintf(tmp, 128, fmt, args);
+        int n = 0;
+        for (const char * f = fmt; *f && n < LOG_ARGS; f++) {
+                if (*f != '%') continue;
+                int longs;
+                f = skipSpec(f + 1, longs);
+                switch (*f) {
+                case 's': entry.args[n++].s = va_arg(args, const char *); break;
+                case 'c':
+                case 'd': case 'i':
+                        entry.args[n++].i = longs == 2 ? va_arg(args, long long) :
+                                            longs ? va_arg(args, long) : va_arg(args, int);
+                        break;
+                case 'u': case 'x': case 'X': case 'o':
+                        entry.args[n++].i = longs == 2 ? va_arg(args, unsigned long long) :
+                                            longs ? va_arg(args, unsigned long) : va_arg(args, unsigned);
+                        break;
+                case 'p': entry.args[n++].s = (const char *) va_arg(args, void *); break;
+                }
+                if (!*f) break;
+        }
         va_end (args);
-        sendString(tmp);
+
+        logRing.push(entry);
+}
+
+//_____________________________________
+// Format a queued entry into logLine
+static void format(const LogEntry & entry) {
+        int len = 0;
+        int n = 0;
+        const char * f = entry.fmt;
+        while (*f && len < LOG_LINE - 1) {
+                if (*f != '%') { logLine[len++] = *f++; continue; }
+
+                // Copy one conversion spec and format its argument alone
+                int longs;
+                const char * conv = skipSpec(f + 1, longs);
+                if (!*conv) break;
+                char spec[16];
+                int specLen = conv - f + 1;
+                if (specLen >= (int) sizeof(spec)) specLen = sizeof(spec) - 1;
+                memcpy(spec, f, specLen);
+                spec[specLen] = 0;
+                f = conv + 1;
+
+                int room = LOG_LINE - len;
+                int out = 0;
+                if (*conv == '%') { logLine[len++] = '%'; continue; }
+                if (n >= LOG_ARGS) break;
+                const LogArg & arg = entry.args[n++];
+                if (*conv == 's') out = snprintf(logLine + len, room, spec, arg.s ? arg.s : "(null)");
+                else if (*conv == 'p') out = snprintf(logLine + len, room, spec, (const void *) arg.s);
+                else if (strchr("cdiuxXo", *conv)) {
+                        if (longs == 2) out = snprintf(logLine + len, room, spec, arg.i);
+                        else if (longs) out = snprintf(logLine + len, room, spec, (long) arg.i);
+                        else out = snprintf(logLine + len, room, spec, (int) arg.i);
+                }
+                if (out < 0) out = 0;
+                len += out < room ? out : room - 1;
+        }
+        logLine[len] = 0;
+        logLen = len;
+        serialPos = telnetPos = 0;
+}
+
+//_____________________________________
+// Format queued messages and hand them to the serial port and telnet
+// without waiting on either.  Returns milliseconds until it wants to
+// run again.
+unsigned long logService() {
+        for (;;) {
+                if (serialPos >= logLen && telnetPos >= logLen) {
+                        LogEntry entry;
+                        if (!logRing.pop(entry)) return 20;
+                        format(entry);
+                }
+
+                if (serialPos < logLen) {
+                        int room = Serial.availableForWrite();
+                        int n = logLen - serialPos;
+                        if (n > room) n = room;
+                        if (n > 0) serialPos += Serial.write((const uint8_t *) logLine + serialPos, n);
+                }
+
+                // Telnet queues the whole string for each client, or
+                // trims what doesn't fit
+                if (telnetPos < logLen) {
+                        TelnetWrite(logLine + telnetPos);
+                        telnetPos = logLen;
+                }
+
+                // A sink is full; come back when it has drained a bit
+                if (serialPos < logLen || telnetPos < logLen) return 10;
+        }
+}
+
+// Number of messages dropped because the sinks fell behind
+unsigned logDrops() {
+        return logRing.drops();
 }
 
   static int showTimer = -1;   ///< limit output to 1-per-Secondary
@@ -37,7 +194,7 @@ void showTime() {
   unsigned int m = (t / 60) % 60;
   unsigned int h = (t / 60 / 60) % 12;
 
-  if ( showTimer == s ) return;
+  if ( showTimer == (int) s ) return;
   showTimer = s;
 
   auto wt = getWallTime();
@@ -102,7 +259,16 @@ bool timeEntry( char ch ) {
 
   timeEntryMode = false ;
   if ( ibuf == 0 ) return false ;
+  ibuf = 0 ;
 
+  // "on:off" followed by 'P' sets the catch-up pulse timing in ms
+  if ( ch == 'P' || ch == 'p' ) {
+    unsigned on = 0 , off = 0 ;
+    if ( sscanf( buf , "%u:%u" , &on , &off ) != 2 || !setPulseTiming( on , off ) )
+      p( "\nBad pulse timing\n" ) ;
+    showConfig() ;
+    return false ;
+  }
 
   return true ;
 }
@@ -121,12 +287,33 @@ bool controlMode( char ch ) {
   return false ;
 }
 
-void consoleService() {
+//_____________________________________
+// Print status reports on request
+void reportMode( char ch ) {
+    switch ( ch ) {
+    case 'W': case 'w': p("\nWakeups: %u/s\n", getWakeupRate()) ; break ;
+    case 'H': case 'h': showPulseStats() ;                         break ;
+    case 'S': case 's': showSaveStats() ;                          break ;
+    case 'L': case 'l': p("\nLog drops: %u\n", logDrops()) ;      break ;
+    case 'T': case 't': showTelnetStats() ;                        break ;
+    case 'K': case 'k': showCatchUp() ; showConfig() ;             break ;
+    case 'D': case 'd': showDst() ;                                break ;
+    case 'C': case 'c': showChannels() ;                           break ;
+    case 'O': case 'o': showOutputStats() ;                        break ;
+    case 'N': case 'n': showNtpStatus() ; showNtpServerStats() ;   break ;
+    case 'F': case 'f': showInputStats() ; showPowerStats() ;      break ;
+    case 'M': case 'm': showMetricsStats() ;                       break ;
+    case 'P': case 'p': showProfile() ;                            break ;
+    case 'I': case 'i': showNetworkStats() ;                       break ;
+    }
+}
+
+unsigned long consoleService() {
   char ch ;
-  bool timeChange = false ;
+  [[maybe_unused]] bool timeChange = false ;    // Read by the disabled code below
 
   ch = readKey();
-  if ( ch < 1 ) return ;
+  if ( ch < 1 ) return 50 ;
 
   if ( isdigit(ch) || ch == ':' ) timeEntryMode = true ;
 
@@ -138,8 +325,13 @@ void consoleService() {
       timeChange = true ;
     }
   }
+  else
+    reportMode( ch ) ;
 
 //   timeChange |= controlMode(ch) ;
 
 //   if ( timeChange ) { p(" -> %02d:%02d ", getMinutes(), getSeconds() );  }
+
+  // More input may be waiting
+  return 0 ;
 }
@@ -10,7 +10,28 @@ void showSignalDrop() ;
 
 // Read/write to console user interface
 // Call this "service" routine frequently to allow user input and console output.
-void consoleService() ;
+// Returns milliseconds until it wants to be called again.
+unsigned long consoleService() ;
 
-// printf-like function for serial port or console
+// printf-like function for serial port or console.  The message is
+// queued and formatted later by logService(), so %s arguments must
+// still be valid then.  String literals always are.
 void p(const char *fmt, ... );
+
+// Log levels.  Messages above LOG_LEVEL compile to nothing.
+#define LOG_ERROR       1
+#define LOG_INFO        2
+#define LOG_DEBUG       3
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL       LOG_INFO
+#endif
+
+#define plog(level, ...) do { if ((level) <= LOG_LEVEL) p(__VA_ARGS__); } while (0)
+
+// Format queued messages and send them to the console sinks.
+// Returns milliseconds until it wants to be called again.
+unsigned long logService() ;
+
+// Number of messages dropped because the sinks fell behind
+unsigned logDrops() ;
@@ -27,27 +27,63 @@
 /* NTP server machine */
 #include "NtpServer.h"
 
+/* Deadline-driven task scheduler */
+#include "Scheduler.h"
+#include "console.h"
+#include "PulseTimer.h"
+#include "TimeSave.h"
+#include "OutputStage.h"
+#include "NtpClient.h"
+#include "Inputs.h"
+#include "MetricsServer.h"
+
 // Input/Output signal pins
 const int pulseA = 14;
 const int pulseB = 12;
 const int pulseD = 13;
 const int RUN = D3;
+#ifndef POWER_PIN
+#define POWER_PIN -1    // Supply monitor, LOW on failure; -1 if not wired
+#endif
+const int POWER = POWER_PIN;
+
+// Pins and zone of each slave-clock channel.  With the default GPIO
+// output stage the signal pins must be among GPIO0-15.
+struct ChannelSetup {
+  int a, b, d;          ///< A, B and D signal pins
+  long shift;           ///< Seconds the clocks run ahead of MYTZ
+};
+
+const ChannelSetup channelSetup[NUM_CHANNELS] = {
+  { pulseA, pulseB, pulseD, 0 },
+};
 
 
 #include <TZ.h>
 //#define MYTZ            TZ_America_Detroit              // Central time
 #define MYTZ TZ_America_Los_Angeles
 
+// Time servers, queried in turn at every poll.  "host:port" works too.
+const char * const ntpServers[] = {
+  "0.pool.ntp.org",
+  "1.pool.ntp.org",
+  "2.pool.ntp.org",
+};
+
 int run_switch()
 {
-  return !digitalRead(RUN);
+  return runSwitch();
+}
+
+long channelShift(int channel)
+{
+  return channelSetup[channel].shift;
 }
 
-void sendSignal( int a, int b, int d)
+// Called from the pulse timer interrupt
+void IRAM_ATTR sendLines(unsigned lines)
 {
-  digitalWrite(pulseA, a);   // Send A pulses
-  digitalWrite(pulseB, b);   // Send B pulses
-  digitalWrite(pulseD, d);   // Send D pulses
+  outputWrite(lines);        // Send A, B and D pulses on every channel
 }
 
 void sendString( const char * str )
@@ -66,25 +102,55 @@ char readKey()
   return (char) Serial.read();
 }
 
+// Every task, in the order a scheduler pass runs them
+struct TaskSetup {
+  Task task;
+  const char * name;    ///< Profiler label
+};
+
+const TaskSetup tasks[] = {
+  { powerService, "power" },
+  { networkService, "network" },
+  { consoleService, "console" },
+  { logService, "log" },
+  { serviceTelnetServer, "telnet" },
+  { serviceMetricsServer, "metrics" },
+  { NtpService, "ntp server" },
+  { ntpClientService, "ntp client" },
+  { ledService, "led" },
+  { service, "service" },
+  { saveService, "save" },
+};
+static_assert(sizeof(tasks) / sizeof(tasks[0]) <= MAX_TASKS, "Too many tasks; raise MAX_TASKS in Scheduler.h");
+
 // the setup routine runs once when you press reset:
 void setup() {
   Serial.begin(115200);
 
-  // Start ESP ntp time service
-  configTime(MYTZ, "pool.ntp.org");
-
-  // initialize the digital pin as an output.
-  pinMode(pulseA, OUTPUT);
-  pinMode(pulseB, OUTPUT);
+  // Local time zone.  Our own NTP client sets the clock, so the ESP's
+  // SNTP client is not started.
+  setenv("TZ", MYTZ, 1);
+  tzset();
+  ntpClientSetup(ntpServers, sizeof(ntpServers) / sizeof(ntpServers[0]));
+
+  // initialize the signal lines as outputs, in CHANNEL_LINES() order
+  int pins[NUM_CHANNELS * LINES_PER_CHANNEL];
+  for (int c = 0; c < NUM_CHANNELS; c++) {
+    pins[c * LINES_PER_CHANNEL + 0] = channelSetup[c].a;
+    pins[c * LINES_PER_CHANNEL + 1] = channelSetup[c].b;
+    pins[c * LINES_PER_CHANNEL + 2] = channelSetup[c].d;
+  }
+  outputSetup(pins, NUM_CHANNELS * LINES_PER_CHANNEL);
   pinMode(LED_BUILTIN, OUTPUT);
-  pinMode(RUN, INPUT_PULLUP); // Use pullup mode to default HIGH
+  inputsSetup(RUN, POWER);
 
   clockSetup();
+  pulseTimerSetup();
+
+  for (auto & t : tasks) addTask(t.task, t.name);
 }
 
 // the loop routine runs over and over again forever:
 void loop() {
-  setupNetwork();
-  service();
-//  serviceTelnetServer();
+  runTasks();
 }
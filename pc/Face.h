@@ -0,0 +1,59 @@
+// Face.h
+//
+// A face driven the way markTime() drives it, one second at a time, on
+// the protocol model in Protocol.h
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Faces are in minutes past 12:00, real time in seconds.  Neither RUN
+// nor forced pulses come into it.
+
+#ifndef FACE_H
+#define FACE_H
+
+#include "clock_generic.h"
+#include "CatchUp.h"
+#include "PulseSchedule.h"
+#include "PulseTimer.h"
+#include "Protocol.h"
+
+// How far real time `now` is ahead of the minute the face shows next,
+// as markTime() works it out
+static inline unsigned faceDelta( unsigned face , unsigned now )
+{
+        return ( MAX_TIME + now - ( face * 60 + 60 ) ) % MAX_TIME ;
+}
+
+// The face after second `now` goes as `plan` says.  Adds the pulses
+// sent to *sent.  If `other` is given, that face is another movement on
+// the same lines, and every pulse sent steps it too.
+static inline unsigned markFace( unsigned face , unsigned now , const CatchUpPlan & plan , unsigned long * sent ,
+                                 unsigned * other = nullptr )
+{
+        unsigned slots[MAX_BURST] = { pulseSignals( now ) } ;
+        unsigned n = 1 ;
+
+        if ( plan.wait ) {
+                slots[0] = ClockProtocol::waitSignals( face , now , slots[0] ) ;
+                face = ClockProtocol::stepFace( face , slots[0] ) ;
+        } else if ( plan.ride ) {
+                slots[0] = ClockProtocol::rideSignals( face , slots[0] ) ;
+                face = ClockProtocol::stepFace( face , slots[0] ) ;
+        } else if ( plan.pulses ) {
+                n = plan.pulses < MAX_BURST ? plan.pulses : MAX_BURST ;
+                face = ClockProtocol::catchUpBurst( face , n , slots ) ;
+        } else {
+                face = ClockProtocol::stepFace( face , slots[0] ) ;
+        }
+
+        for ( unsigned i = 0 ; i < n ; i++ ) {
+                if ( slots[i] ) ++*sent ;
+                if ( other ) *other = ClockProtocol::stepFace( *other , slots[i] ) ;
+        }
+        return face ;
+}
+
+#endif
@@ -0,0 +1,193 @@
+// LittleFS.cpp
+//
+// A small flash filesystem in shared memory, so files outlive boots
+// and power cuts.  Each write that reaches a file counts as a flash
+// write, for checks on wear.
+
+#include <LittleFS.h>
+#include "Sim.h"
+
+#define MAX_FILES       16
+#define FILE_BYTES      8192
+#define NAME_BYTES      32
+
+struct FlashFile {
+        char name[NAME_BYTES] ;         ///< Empty if the slot is free
+        size_t size ;
+        uint8_t data[FILE_BYTES] ;
+} ;
+
+struct Flash {
+        FlashFile files[MAX_FILES] ;
+        unsigned long writes ;
+} ;
+
+static Flash & flash = *(Flash *) simShared( sizeof( Flash ) ) ;
+
+fs::FS LittleFS ;
+
+// No directories: "/a.txt" and "a.txt" are the same file
+static const char * baseName( const char * path )
+{
+        return *path == '/' ? path + 1 : path ;
+}
+
+static int findFile( const char * path )
+{
+        path = baseName( path ) ;
+        for ( int i = 0 ; i < MAX_FILES ; i++ )
+                if ( flash.files[i].name[0] && !strcmp( flash.files[i].name , path ) ) return i ;
+        return -1 ;
+}
+
+static int createFile( const char * path )
+{
+        path = baseName( path ) ;
+        if ( strlen( path ) >= NAME_BYTES ) return -1 ;
+        for ( int i = 0 ; i < MAX_FILES ; i++ ) {
+                auto & f = flash.files[i] ;
+                if ( f.name[0] ) continue ;
+                strcpy( f.name , path ) ;
+                f.size = 0 ;
+                return i ;
+        }
+        return -1 ;
+}
+
+//_____________________________________________________________________
+//                                                           FILESYSTEM
+
+namespace fs {
+
+bool FS::begin() { return true ; }
+
+File FS::open( const char * path , const char * mode )
+{
+        int i = findFile( path ) ;
+        bool write = mode[0] != 'r' || mode[1] == '+' ;
+        if ( mode[0] == 'r' ) {
+                if ( i < 0 ) return File() ;
+        } else {
+                if ( i < 0 ) i = createFile( path ) ;
+                if ( i < 0 ) return File() ;
+                if ( mode[0] == 'w' ) {
+                        flash.files[i].size = 0 ;
+                        ++flash.writes ;
+                }
+        }
+        File f( i , write ) ;
+        if ( mode[0] == 'a' ) f.seek( 0 , SeekEnd ) ;
+        return f ;
+}
+
+bool FS::exists( const char * path ) { return findFile( path ) >= 0 ; }
+
+bool FS::remove( const char * path )
+{
+        int i = findFile( path ) ;
+        if ( i < 0 ) return false ;
+        flash.files[i].name[0] = 0 ;
+        ++flash.writes ;
+        return true ;
+}
+
+//_____________________________________________________________________
+//                                                                FILES
+
+size_t File::write( const uint8_t * buf , size_t n )
+{
+        if ( index < 0 || !writable ) return 0 ;
+        auto & f = flash.files[index] ;
+        if ( pos > FILE_BYTES ) return 0 ;
+        n = std::min( n , FILE_BYTES - pos ) ;
+        if ( pos > f.size ) memset( f.data + f.size , 0 , pos - f.size ) ;
+        memcpy( f.data + pos , buf , n ) ;
+        pos += n ;
+        if ( pos > f.size ) f.size = pos ;
+        if ( n ) ++flash.writes ;
+        return n ;
+}
+
+int File::available()
+{
+        if ( index < 0 ) return 0 ;
+        return pos < flash.files[index].size ? flash.files[index].size - pos : 0 ;
+}
+
+int File::read()
+{
+        if ( !available() ) return -1 ;
+        return flash.files[index].data[pos++] ;
+}
+
+size_t File::read( uint8_t * buf , size_t n )
+{
+        n = std::min( n , (size_t) available() ) ;
+        if ( n ) memcpy( buf , flash.files[index].data + pos , n ) ;
+        pos += n ;
+        return n ;
+}
+
+int File::peek()
+{
+        if ( !available() ) return -1 ;
+        return flash.files[index].data[pos] ;
+}
+
+bool File::seek( uint32_t offset , SeekMode mode )
+{
+        if ( index < 0 ) return false ;
+        long to = offset ;
+        if ( mode == SeekCur ) to += pos ;
+        if ( mode == SeekEnd ) to += flash.files[index].size ;
+        if ( to < 0 || to > (long) flash.files[index].size ) return false ;
+        pos = to ;
+        return true ;
+}
+
+size_t File::size() const
+{
+        return index < 0 ? 0 : flash.files[index].size ;
+}
+
+bool File::truncate( uint32_t size )
+{
+        if ( index < 0 || !writable || size > flash.files[index].size ) return false ;
+        flash.files[index].size = size ;
+        ++flash.writes ;
+        return true ;
+}
+
+}
+
+//_____________________________________________________________________
+//                                                         WORLD'S SIDE
+
+void simWriteFile( const char * name , const void * data , size_t size )
+{
+        int i = findFile( name ) ;
+        if ( i < 0 ) i = createFile( name ) ;
+        if ( i < 0 || size > FILE_BYTES ) {
+                fprintf( stderr , "sim: no room for %s\n" , name ) ;
+                exit( 2 ) ;
+        }
+        memcpy( flash.files[i].data , data , size ) ;
+        flash.files[i].size = size ;
+}
+
+long simReadFile( const char * name , void * data , size_t size )
+{
+        int i = findFile( name ) ;
+        if ( i < 0 ) return -1 ;
+        size = std::min( size , flash.files[i].size ) ;
+        memcpy( data , flash.files[i].data , size ) ;
+        return size ;
+}
+
+void simRemoveFile( const char * name )
+{
+        int i = findFile( name ) ;
+        if ( i >= 0 ) flash.files[i].name[0] = 0 ;
+}
+
+unsigned long simFlashWrites() { return flash.writes ; }
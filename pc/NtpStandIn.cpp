@@ -0,0 +1,131 @@
+// NtpStandIn.cpp
+//
+// SNTP servers on the simulated network; see NtpStandIn.h
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "NtpClient.h"
+#include "NtpStandIn.h"
+#include "Sim.h"
+
+#define MAX_STAND_INS   4
+#define MAX_REPLIES     16      // Replies on their way back
+
+struct Reply {
+        bool busy ;
+        int server ;
+        uint8_t packet[NTP_PACKET] ;
+        sockaddr_in to ;
+} ;
+
+struct StandIns {
+        NtpStandIn servers[MAX_STAND_INS] ;
+        unsigned count ;
+        Reply replies[MAX_REPLIES] ;
+} ;
+
+static StandIns * standIns = nullptr ;
+
+static void writeStamp( uint8_t * p , int64_t unixUs )
+{
+        uint64_t us = unixUs + NTP_UNIX_EPOCH * 1000000 ;
+        uint32_t sec = us / 1000000 ;
+        uint32_t frac = ( ( us % 1000000 ) << 32 ) / 1000000 ;
+        for ( int i = 0 ; i < 4 ; i++ ) {
+                p[i] = sec >> ( 24 - 8 * i ) ;
+                p[4 + i] = frac >> ( 24 - 8 * i ) ;
+        }
+}
+
+static void sendReply( intptr_t slot )
+{
+        auto & r = standIns->replies[slot] ;
+        auto & s = standIns->servers[r.server] ;
+        sendto( s.fd , r.packet , sizeof r.packet , 0 , (sockaddr *) &r.to , sizeof r.to ) ;
+        ++s.replies ;
+        r.busy = false ;
+}
+
+// Build the reply to one request, stamped as it arrives after outUs
+static void answer( int server , const uint8_t * request , const sockaddr_in & from )
+{
+        auto & s = standIns->servers[server] ;
+        int slot = 0 ;
+        while ( slot < MAX_REPLIES && standIns->replies[slot].busy ) slot++ ;
+        if ( slot == MAX_REPLIES ) return ;
+
+        auto & r = standIns->replies[slot] ;
+        r.busy = true ;
+        r.server = server ;
+        r.to = from ;
+
+        auto & p = r.packet ;
+        int64_t arrived = simUtcUs() + s.outUs + s.offsetUs ;
+        memset( p , 0 , sizeof p ) ;
+        p[0] = s.leap << 6 | 4 << 3 | 4 ;       // Version 4, server
+        p[1] = s.stratum ;
+        p[2] = 6 ;                              // Poll
+        p[3] = (uint8_t) -20 ;                  // Precision, about a microsecond
+        memcpy( p + 12 , "SIM" , 4 ) ;
+        writeStamp( p + 16 , arrived ) ;        // Reference time
+        memcpy( p + 24 , request + 40 , 8 ) ;   // Origin: the client's transmit time
+        if ( s.badOrigin ) p[31] ^= 0x55 ;
+        writeStamp( p + 32 , arrived ) ;        // Receive
+        writeStamp( p + 40 , arrived ) ;        // Transmit, turned round at once
+
+        simAt( simNow() + s.outUs + s.backUs , sendReply , slot ) ;
+}
+
+// The firmware just sent a packet: read any requests that reached us
+static void poll()
+{
+        for ( unsigned i = 0 ; i < standIns->count ; i++ ) {
+                auto & s = standIns->servers[i] ;
+                uint8_t request[NTP_PACKET + 16] ;
+                sockaddr_in from ;
+                socklen_t len = sizeof from ;
+                int n ;
+                while ( ( n = recvfrom( s.fd , request , sizeof request , MSG_DONTWAIT , (sockaddr *) &from , &len ) ) >= 0 ) {
+                        len = sizeof from ;
+                        ++s.requests ;
+                        if ( n < NTP_PACKET || ( request[0] & 7 ) != 3 || !s.answering ) continue ;
+                        answer( i , request , from ) ;
+                }
+        }
+}
+
+NtpStandIn & ntpStandIn( int host , const char * name )
+{
+        if ( !standIns ) standIns = (StandIns *) simShared( sizeof( StandIns ) ) ;
+        if ( standIns->count >= MAX_STAND_INS ) {
+                fprintf( stderr , "sim: too many NTP stand-ins\n" ) ;
+                exit( 2 ) ;
+        }
+
+        auto & s = standIns->servers[standIns->count++] ;
+        s = NtpStandIn() ;
+        s.stratum = 2 ;
+        s.answering = true ;
+        s.outUs = s.backUs = 5000 ;
+        s.host = host ;
+
+        s.fd = socket( AF_INET , SOCK_DGRAM , 0 ) ;
+        sockaddr_in a = {} ;
+        a.sin_family = AF_INET ;
+        a.sin_addr.s_addr = simAddress( host ) ;
+        a.sin_port = htons( NTP_PORT + SIM_PORT_OFFSET ) ;
+        if ( s.fd < 0 || bind( s.fd , (sockaddr *) &a , sizeof a ) < 0 ) {
+                perror( "sim: NTP stand-in" ) ;
+                exit( 2 ) ;
+        }
+
+        simHost( name , host ) ;
+        simOnSend( poll ) ;
+        return s ;
+}
@@ -0,0 +1,43 @@
+// NtpStandIn.h
+//
+// SNTP servers on the simulated network
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Each stand-in is a real UDP socket on its simulated host's address.
+// When the firmware sends a packet the stand-ins read their requests
+// and queue the replies as world events, so a request spends `outUs`
+// on the way there and the reply `backUs` on the way back, in virtual
+// time.  A reply is stamped with the world's reference UTC at the
+// moment the request arrived, plus `offsetUs`.
+
+#ifndef NTP_STAND_IN_H
+#define NTP_STAND_IN_H
+
+#include <stdint.h>
+
+struct NtpStandIn {
+        // How the server behaves; change them at any time
+        long offsetUs ;         ///< Error of the server's clock
+        long outUs , backUs ;   ///< One-way network delays
+        uint8_t stratum ;       ///< 0 makes it a kiss-of-death reply
+        uint8_t leap ;          ///< 3 means unsynchronized
+        bool answering ;        ///< False drops every request
+        bool badOrigin ;        ///< Answer with a wrong origin timestamp
+
+        // What it saw
+        unsigned long requests ;
+        unsigned long replies ;
+
+        int host ;              ///< Simulated host number
+        int fd ;
+} ;
+
+// Start a server on simulated host `host` under `name`.  Call before the
+// first boot; the server lives in shared memory.
+NtpStandIn & ntpStandIn( int host , const char * name ) ;
+
+#endif
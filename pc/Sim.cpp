@@ -0,0 +1,663 @@
+// Sim.cpp
+//
+// The simulated world: virtual time, boots, pins, timer1, RTC memory,
+// the serial port and the network's bookkeeping.  See Sim.h.
+
+//_____________________________________________________________________
+//                                                             INCLUDES
+#include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <new>
+
+#include "Arduino.h"
+#include <coredecls.h>
+#include "Sim.h"
+
+//_____________________________________________________________________
+//                                                            CONSTANTS
+
+#define SHARED_BYTES    ( 4 << 20 )     // World, flash and the checks' state
+#define MAX_EVENTS      128
+#define MAX_HOSTS       16
+#define PINS            17              // GPIO0-16
+#define RTC_BYTES       512             // RTC user memory
+#define KEY_BUFFER      256
+#define LOOP_US         50              // Virtual CPU time of one loop() pass
+
+//_____________________________________________________________________
+//                                                                WORLD
+
+struct Event {
+        uint64_t t ;
+        SimEvent fn ;
+        intptr_t arg ;
+} ;
+
+// Everything that outlives a boot.  It sits in shared memory, so the
+// boots and this process see the same world.
+struct World {
+        uint64_t now ;                  ///< Virtual microseconds
+        int64_t utcStart ;              ///< Reference UTC at now = 0, in us
+
+        // The ESP's system clock: clockBase at virtual time clockAt,
+        // running ppb fast since
+        int64_t clockBase ;
+        uint64_t clockAt ;
+        long ppb ;
+
+        uint64_t bootAt ;               ///< Virtual time micros() counts from
+        uint64_t bootMicros ;           ///< micros() at the start of the next boot
+        bool wrap32 ;
+
+        bool booted ;                   ///< A boot is running the firmware
+        bool poweredOn ;
+        bool done ;
+        unsigned boots ;
+
+        uint8_t input[PINS] ;
+        uint32_t outputs ;              ///< Output levels, bit n for GPIO n
+        void ( * onPins )( uint32_t ) ;
+
+        uint32_t rtc[RTC_BYTES / 4] ;
+
+        Event events[MAX_EVENTS] ;
+        unsigned nEvents ;
+        uint64_t nextEvent ;            ///< Earliest event time, or ~0
+
+        bool wifiUp ;
+        unsigned wifiChanges ;          ///< Link ups and downs so far
+        struct { char name[48] ; int host ; } hosts[MAX_HOSTS] ;
+        unsigned nHosts ;
+        uint8_t net[2] ;                ///< Second and third octets of our 127/8 net
+        void ( * onSend )() ;
+
+        char keys[KEY_BUFFER] ;
+        unsigned keyHead , keyTail ;
+
+        size_t sharedUsed ;
+} ;
+
+static World * w = nullptr ;
+static uint8_t * arena = nullptr ;
+
+static void makeWorld()
+{
+        void * mem = mmap( nullptr , SHARED_BYTES , PROT_READ | PROT_WRITE , MAP_SHARED | MAP_ANONYMOUS , -1 , 0 ) ;
+        if ( mem == MAP_FAILED ) {
+                perror( "sim: mmap" ) ;
+                exit( 2 ) ;
+        }
+        w = new ( mem ) World() ;
+        arena = (uint8_t *) mem ;
+        w->sharedUsed = ( sizeof( World ) + 15 ) & ~15 ;
+        w->poweredOn = true ;
+        w->wifiUp = true ;
+        w->nextEvent = ~0ULL ;
+        memset( w->input , HIGH , sizeof w->input ) ;
+        pid_t pid = getpid() ;
+        w->net[0] = 1 + pid % 250 ;
+        w->net[1] = pid / 250 % 256 ;
+}
+
+static World & world()
+{
+        if ( !w ) makeWorld() ;
+        return *w ;
+}
+
+void * simShared( size_t size )
+{
+        auto & v = world() ;
+        if ( v.sharedUsed + size > SHARED_BYTES ) {
+                fprintf( stderr , "sim: out of shared memory\n" ) ;
+                exit( 2 ) ;
+        }
+        void * p = arena + v.sharedUsed ;
+        v.sharedUsed = ( v.sharedUsed + size + 15 ) & ~15 ;
+        return p ;
+}
+
+double simWallSeconds()
+{
+        timespec ts ;
+        clock_gettime( CLOCK_MONOTONIC , &ts ) ;
+        return ts.tv_sec + ts.tv_nsec * 1e-9 ;
+}
+
+//_____________________________________________________________________
+//                                                   PER-BOOT HARDWARE
+//
+// A fresh boot starts with these as this process left them, which is
+// how the firmware never saw them.
+
+static bool inBoot = false ;            ///< This process is a boot
+
+static timercallback timerIsr = nullptr ;
+static uint8_t timerDivider = TIM_DIV16 ;
+static bool timerReload = false ;
+static bool timerArmed = false ;
+static uint64_t timerDue = 0 ;
+static uint64_t timerPeriod = 0 ;
+
+static void ( * pinIsr[PINS] )() ;
+static int pinIsrMode[PINS] ;
+static uint8_t pinModes[PINS] ;
+
+static void ( * timeSetCb )() = nullptr ;
+
+//_____________________________________________________________________
+//                                                         VIRTUAL TIME
+
+uint64_t simNow() { return world().now ; }
+
+void simSetUtc( time_t utc ) { world().utcStart = (int64_t) utc * 1000000 - (int64_t) world().now ; }
+
+int64_t simUtcUs() { return world().utcStart + (int64_t) world().now ; }
+
+void simStepUtc( int64_t us ) { world().utcStart += us ; }
+
+// The ESP's system clock, in microseconds since the epoch
+static int64_t clockUs()
+{
+        auto & v = world() ;
+        int64_t run = v.now - v.clockAt ;
+        return v.clockBase + run + run * v.ppb / 1000000000 ;
+}
+
+static void setClockUs( int64_t us )
+{
+        auto & v = world() ;
+        v.clockBase = us ;
+        v.clockAt = v.now ;
+}
+
+void simDrift( long ppb )
+{
+        setClockUs( clockUs() ) ;
+        world().ppb = ppb ;
+}
+
+void simWrap32( bool on ) { world().wrap32 = on ; }
+
+void simBootMicros( uint64_t us )
+{
+        auto & v = world() ;
+        v.bootMicros = us ;
+        if ( !inBoot ) v.bootAt = v.now - us ;
+}
+
+static uint64_t bootMicros()
+{
+        auto & v = world() ;
+        uint64_t us = v.now - v.bootAt ;
+        return v.wrap32 ? (uint32_t) us : us ;
+}
+
+unsigned long micros() { return bootMicros() ; }
+
+unsigned long millis()
+{
+        uint64_t ms = ( world().now - world().bootAt ) / 1000 ;
+        return world().wrap32 ? (uint32_t) ms : ms ;
+}
+
+uint32_t EspClass::getCycleCount()
+{
+        return ( world().now - world().bootAt ) * 80 ;
+}
+
+// Time as the firmware's libc sees it.  These replace the C library's
+// own, so TimeService and the NTP code run on the virtual system clock.
+extern "C" time_t time( time_t * t ) __THROW
+{
+        int64_t us = clockUs() ;
+        time_t s = us >= 0 ? us / 1000000 : -( ( 999999 - us ) / 1000000 ) ;
+        if ( t ) *t = s ;
+        return s ;
+}
+
+extern "C" int gettimeofday( struct timeval * __restrict tv , void * __restrict ) __THROW
+{
+        int64_t us = clockUs() ;
+        int64_t s = us >= 0 ? us / 1000000 : -( ( 999999 - us ) / 1000000 ) ;
+        tv->tv_sec = s ;
+        tv->tv_usec = us - s * 1000000 ;
+        return 0 ;
+}
+
+extern "C" int settimeofday( const struct timeval * tv , const struct timezone * ) __THROW
+{
+        if ( tv ) setClockUs( (int64_t) tv->tv_sec * 1000000 + tv->tv_usec ) ;
+        if ( timeSetCb ) timeSetCb() ;
+        return 0 ;
+}
+
+void settimeofday_cb( void ( * cb )() ) { timeSetCb = cb ; }
+
+//_____________________________________________________________________
+//                                                               EVENTS
+
+static void findNextEvent()
+{
+        auto & v = world() ;
+        v.nextEvent = ~0ULL ;
+        for ( unsigned i = 0 ; i < v.nEvents ; i++ )
+                if ( v.events[i].t < v.nextEvent ) v.nextEvent = v.events[i].t ;
+}
+
+void simAt( uint64_t t , SimEvent fn , intptr_t arg )
+{
+        auto & v = world() ;
+        if ( v.nEvents >= MAX_EVENTS ) {
+                fprintf( stderr , "sim: event queue full\n" ) ;
+                exit( 2 ) ;
+        }
+        v.events[v.nEvents++] = { t , fn , arg } ;
+        if ( t < v.nextEvent ) v.nextEvent = t ;
+}
+
+// Take the earliest event off the queue and run it.  Events at the same
+// time run in the order they were queued.
+static void runEvent()
+{
+        auto & v = world() ;
+        unsigned first = 0 ;
+        for ( unsigned i = 1 ; i < v.nEvents ; i++ )
+                if ( v.events[i].t < v.events[first].t ) first = i ;
+        Event e = v.events[first] ;
+        memmove( v.events + first , v.events + first + 1 , ( v.nEvents - first - 1 ) * sizeof( Event ) ) ;
+        --v.nEvents ;
+        findNextEvent() ;
+        e.fn( e.arg ) ;
+}
+
+static uint64_t ticksToUs( uint32_t ticks )
+{
+        switch ( timerDivider ) {
+                case TIM_DIV1 :   return ticks / 80 ;
+                case TIM_DIV256 : return ticks * 16ULL / 5 ;
+                default :         return ticks / 5 ;
+        }
+}
+
+bool simStep( uint64_t until )
+{
+        auto & v = world() ;
+        bool timer = timerArmed && timerDue <= until ;
+        bool event = v.nextEvent <= until && ( !timer || v.nextEvent < timerDue ) ;
+
+        if ( timer && !event ) {
+                if ( timerDue > v.now ) v.now = timerDue ;
+                if ( timerReload ) timerDue += timerPeriod ;
+                else timerArmed = false ;
+                if ( timerIsr ) timerIsr() ;
+                return true ;
+        }
+        if ( event ) {
+                if ( v.nextEvent > v.now ) v.now = v.nextEvent ;
+                runEvent() ;
+                return true ;
+        }
+        if ( until > v.now ) v.now = until ;
+        return false ;
+}
+
+void simSpend( uint64_t us )
+{
+        uint64_t until = world().now + us ;
+        while ( simStep( until ) ) ;
+}
+
+void delay( unsigned long ms ) { simSpend( ms * 1000ULL ) ; }
+
+void yield() { simSpend( 0 ) ; }
+
+void esp_schedule() {}
+
+//_____________________________________________________________________
+//                                                                BOOTS
+
+void setup() ;
+void loop() ;
+
+// Tell the world about new output levels
+static void setOutputs( uint32_t levels )
+{
+        auto & v = world() ;
+        if ( levels == v.outputs ) return ;
+        v.outputs = levels ;
+        if ( v.onPins ) v.onPins( levels ) ;
+}
+
+// End this boot: the pins float low and the process goes away
+static void endBoot( SimEnd how )
+{
+        setOutputs( 0 ) ;
+        world().booted = false ;
+        fflush( stdout ) ;
+        fflush( stderr ) ;
+        _exit( how ) ;
+}
+
+SimEnd simBoot()
+{
+        auto & v = world() ;
+        fflush( stdout ) ;
+        fflush( stderr ) ;
+        v.poweredOn = true ;
+
+        pid_t pid = fork() ;
+        if ( pid < 0 ) {
+                perror( "sim: fork" ) ;
+                exit( 2 ) ;
+        }
+        if ( !pid ) {
+                inBoot = true ;
+                v.booted = true ;
+                ++v.boots ;
+                v.bootAt = v.now - v.bootMicros ;
+                v.bootMicros = 0 ;
+                setClockUs( 0 ) ;               // The system clock starts at the epoch
+                setup() ;
+                for ( ;; ) {
+                        loop() ;
+                        simSpend( LOOP_US ) ;
+                }
+        }
+
+        int status ;
+        while ( waitpid( pid , &status , 0 ) < 0 && errno == EINTR ) ;
+        v.booted = false ;
+        if ( WIFSIGNALED( status ) ) {
+                fprintf( stderr , "sim: firmware died: %s\n" , strsignal( WTERMSIG( status ) ) ) ;
+                exit( 2 ) ;
+        }
+        int how = WEXITSTATUS( status ) ;
+        if ( how < SIM_POWER_CUT || how > SIM_DONE ) {
+                fprintf( stderr , "sim: firmware exited with %d\n" , how ) ;
+                exit( 2 ) ;
+        }
+        if ( how == SIM_DONE ) v.done = true ;
+        return (SimEnd) how ;
+}
+
+bool simIdle()
+{
+        auto & v = world() ;
+        while ( !v.poweredOn && !v.done ) {
+                if ( v.nextEvent == ~0ULL ) {
+                        fprintf( stderr , "sim: powered off with nothing left to happen\n" ) ;
+                        exit( 2 ) ;
+                }
+                simStep( v.nextEvent ) ;
+        }
+        return !v.done ;
+}
+
+void simPowerCut()
+{
+        auto & v = world() ;
+        v.poweredOn = false ;
+
+        // RTC memory does not survive, and comes back as noise
+        uint32_t x = v.now ^ 0x9e3779b9 ;
+        for ( auto & word : v.rtc ) {
+                x ^= x << 13 ;
+                x ^= x >> 17 ;
+                x ^= x << 5 ;
+                word = x ;
+        }
+        if ( inBoot ) endBoot( SIM_POWER_CUT ) ;
+}
+
+void simReset()
+{
+        if ( inBoot ) endBoot( SIM_RESET ) ;
+}
+
+void simPowerOn() { world().poweredOn = true ; }
+
+void simDone()
+{
+        world().done = true ;
+        if ( inBoot ) endBoot( SIM_DONE ) ;
+}
+
+bool simRunning() { return world().booted ; }
+
+unsigned simBoots() { return world().boots ; }
+
+void EspClass::restart() { simReset() ; }
+
+//_____________________________________________________________________
+//                                                                 PINS
+
+void pinMode( uint8_t pin , uint8_t mode )
+{
+        if ( pin < PINS ) pinModes[pin] = mode ;
+}
+
+void digitalWrite( uint8_t pin , uint8_t level )
+{
+        if ( pin >= PINS ) return ;
+        uint32_t bit = 1UL << pin ;
+        setOutputs( level ? world().outputs | bit : world().outputs & ~bit ) ;
+}
+
+int digitalRead( uint8_t pin )
+{
+        if ( pin >= PINS ) return LOW ;
+        if ( pinModes[pin] == OUTPUT ) return ( world().outputs >> pin ) & 1 ;
+        return world().input[pin] ;
+}
+
+void attachInterrupt( uint8_t pin , void ( * isr )() , int mode )
+{
+        if ( pin >= PINS ) return ;
+        pinIsr[pin] = isr ;
+        pinIsrMode[pin] = mode ;
+}
+
+void detachInterrupt( uint8_t pin )
+{
+        if ( pin < PINS ) pinIsr[pin] = nullptr ;
+}
+
+void simInput( int pin , int level )
+{
+        auto & v = world() ;
+        if ( pin < 0 || pin >= PINS ) return ;
+        level = level ? HIGH : LOW ;
+        if ( v.input[pin] == level ) return ;
+        v.input[pin] = level ;
+        int edge = level ? RISING : FALLING ;
+        if ( pinIsr[pin] && ( pinIsrMode[pin] & edge ) ) pinIsr[pin]() ;
+}
+
+int simOutput( int pin ) { return ( world().outputs >> pin ) & 1 ; }
+
+void simOnPins( void ( * fn )( uint32_t ) ) { world().onPins = fn ; }
+
+SimGpio GPO { SimGpio::OUT } , GPOS { SimGpio::SET } , GPOC { SimGpio::CLEAR } ;
+
+SimGpio & SimGpio::operator=( uint32_t value )
+{
+        uint32_t levels = world().outputs ;
+        switch ( kind ) {
+                case OUT :   levels = ( levels & ~0xffffUL ) | ( value & 0xffff ) ; break ;
+                case SET :   levels |= value & 0xffff ; break ;
+                case CLEAR : levels &= ~( value & 0xffff ) ; break ;
+        }
+        setOutputs( levels ) ;
+        return *this ;
+}
+
+SimGpio::operator uint32_t() const
+{
+        return kind == OUT ? world().outputs & 0xffff : 0 ;
+}
+
+//_____________________________________________________________________
+//                                                               TIMER1
+
+void timer1_attachInterrupt( timercallback isr ) { timerIsr = isr ; }
+void timer1_detachInterrupt() { timerIsr = nullptr ; }
+
+void timer1_enable( uint8_t divider , uint8_t , uint8_t reload )
+{
+        timerDivider = divider ;
+        timerReload = reload == TIM_LOOP ;
+}
+
+void timer1_write( uint32_t ticks )
+{
+        timerPeriod = ticksToUs( ticks ) ;
+        timerDue = world().now + timerPeriod ;
+        timerArmed = true ;
+}
+
+void timer1_disable() { timerArmed = false ; }
+
+//_____________________________________________________________________
+//                                                     RTC USER MEMORY
+
+bool EspClass::rtcUserMemoryRead( uint32_t offset , uint32_t * data , size_t size )
+{
+        if ( offset > RTC_BYTES / 4 - 1 || offset * 4 + size > RTC_BYTES || !size ) return false ;
+        memcpy( data , (uint8_t *) world().rtc + offset * 4 , size ) ;
+        return true ;
+}
+
+bool EspClass::rtcUserMemoryWrite( uint32_t offset , uint32_t * data , size_t size )
+{
+        if ( offset > RTC_BYTES / 4 - 1 || offset * 4 + size > RTC_BYTES || !size ) return false ;
+        memcpy( (uint8_t *) world().rtc + offset * 4 , data , size ) ;
+        return true ;
+}
+
+EspClass ESP ;
+
+//_____________________________________________________________________
+//                                                          SERIAL PORT
+
+HardwareSerial Serial ;
+
+static bool echoSerial()
+{
+        static int echo = -1 ;
+        if ( echo < 0 ) echo = getenv( "SIM_SERIAL" ) && atoi( getenv( "SIM_SERIAL" ) ) ;
+        return echo ;
+}
+
+size_t HardwareSerial::write( uint8_t c ) { return write( &c , 1 ) ; }
+
+size_t HardwareSerial::write( const uint8_t * buf , size_t n )
+{
+        if ( echoSerial() ) fwrite( buf , 1 , n , stderr ) ;
+        return n ;
+}
+
+int HardwareSerial::available() { return world().keyHead - world().keyTail ; }
+
+int HardwareSerial::read()
+{
+        auto & v = world() ;
+        if ( v.keyHead == v.keyTail ) return -1 ;
+        return (uint8_t) v.keys[v.keyTail++ % KEY_BUFFER] ;
+}
+
+int HardwareSerial::peek()
+{
+        auto & v = world() ;
+        if ( v.keyHead == v.keyTail ) return -1 ;
+        return (uint8_t) v.keys[v.keyTail % KEY_BUFFER] ;
+}
+
+void simType( const char * keys )
+{
+        auto & v = world() ;
+        for ( ; *keys && v.keyHead - v.keyTail < KEY_BUFFER ; keys++ )
+                v.keys[v.keyHead++ % KEY_BUFFER] = *keys ;
+}
+
+//_____________________________________________________________________
+//                                                       PRINT / STREAM
+
+size_t Print::write( const uint8_t * buf , size_t n )
+{
+        size_t done = 0 ;
+        while ( done < n && write( buf[done] ) ) done++ ;
+        return done ;
+}
+
+size_t Print::printf( const char * format , ... )
+{
+        char buf[256] ;
+        va_list args ;
+        va_start( args , format ) ;
+        int n = vsnprintf( buf , sizeof buf , format , args ) ;
+        va_end( args ) ;
+        if ( n < 0 ) return 0 ;
+        return write( (const uint8_t *) buf , std::min( (size_t) n , sizeof buf - 1 ) ) ;
+}
+
+long Stream::parseInt()
+{
+        int c ;
+        while ( ( c = peek() ) >= 0 && c != '-' && !isdigit( c ) ) read() ;
+        if ( c < 0 ) return 0 ;
+
+        bool negative = c == '-' ;
+        if ( negative ) read() ;
+        long value = 0 ;
+        while ( ( c = peek() ) >= 0 && isdigit( c ) ) {
+                value = value * 10 + c - '0' ;
+                read() ;
+        }
+        return negative ? -value : value ;
+}
+
+//_____________________________________________________________________
+//                                                              NETWORK
+
+void simWifi( bool up )
+{
+        auto & v = world() ;
+        if ( v.wifiUp == up ) return ;
+        v.wifiUp = up ;
+        ++v.wifiChanges ;
+}
+
+uint32_t simAddress( int host )
+{
+        auto & v = world() ;
+        return 127 | v.net[0] << 8 | v.net[1] << 16 | (uint32_t) host << 24 ;
+}
+
+void simHost( const char * name , int host )
+{
+        auto & v = world() ;
+        if ( v.nHosts >= MAX_HOSTS ) return ;
+        snprintf( v.hosts[v.nHosts].name , sizeof v.hosts[0].name , "%s" , name ) ;
+        v.hosts[v.nHosts++].host = host ;
+}
+
+void simOnSend( void ( * fn )() ) { world().onSend = fn ; }
+
+// For WiFi.cpp
+bool simLinkUp() { return world().wifiUp ; }
+unsigned simLinkChanges() { return world().wifiChanges ; }
+void simSent() { if ( world().onSend ) world().onSend() ; }
+
+int simLookup( const char * name )
+{
+        auto & v = world() ;
+        for ( unsigned i = 0 ; i < v.nHosts ; i++ )
+                if ( !strcmp( v.hosts[i].name , name ) ) return v.hosts[i].host ;
+        return -1 ;
+}
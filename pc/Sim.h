@@ -0,0 +1,160 @@
+// Sim.h
+//
+// The world around the firmware, for the host build
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// The stand-ins in include/ run the master_clock sources on Linux
+// against a virtual clock.  Nothing waits in real time: when the
+// firmware sleeps, virtual time jumps to the next timer1 interrupt or
+// world event, so days of operation run in seconds.
+//
+// Everything that outlives a boot lives in memory shared with the boots:
+// virtual time, the input pins, RTC user memory, the flash files, the
+// ESP's system clock and the event queue.  simBoot() forks a child that
+// starts from the pristine globals of this process, runs setup() and
+// loop() until an event cuts the power or resets the chip, and returns
+// how it ended.  A power cut loses RTC memory and the system clock; a
+// reset keeps RTC memory.
+//
+// A check keeps its own state that must outlive a boot in simShared()
+// memory, and watches the output lines with simOnPins().
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+//_____________________________________________________________________
+//                                                         VIRTUAL TIME
+
+// Microseconds since the world began.  Never wraps.
+uint64_t simNow() ;
+
+// Reference UTC at the start of the world, and now.  NTP stand-ins
+// serve it; the ESP's system clock starts at zero on every boot and
+// drifts from it.
+void simSetUtc( time_t utc ) ;
+int64_t simUtcUs() ;
+
+// Step the reference time, as a corrected upstream server would
+void simStepUtc( int64_t us ) ;
+
+// Crystal error of the ESP, in parts per billion.  Positive runs fast.
+void simDrift( long ppb ) ;
+
+// Run the world on by `us`, firing timer1 and events on the way.  Used
+// by checks that call firmware functions directly, between calls.
+void simSpend( uint64_t us ) ;
+
+// Make micros() and millis() wrap at 32 bits like the ESP's.  Off by
+// default: host longs are 64 bits wide, and only Timer.cpp and
+// Scheduler.cpp care.
+void simWrap32( bool on ) ;
+
+// Start micros() near its wrap.  The next boot, or now for a check
+// without boots, counts from `us` instead of zero.
+void simBootMicros( uint64_t us ) ;
+
+//_____________________________________________________________________
+//                                                               EVENTS
+
+typedef void ( * SimEvent )( intptr_t arg ) ;
+
+// Call fn(arg) when virtual time reaches t.  Events carry over boots.
+void simAt( uint64_t t , SimEvent fn , intptr_t arg = 0 ) ;
+
+//_____________________________________________________________________
+//                                                                BOOTS
+
+enum SimEnd {
+        SIM_POWER_CUT = 1 ,     ///< The supply went away
+        SIM_RESET ,             ///< Watchdog or software reset
+        SIM_DONE ,              ///< The scenario is over
+} ;
+
+// Power the ESP up and run the firmware until it stops
+SimEnd simBoot() ;
+
+// With the power off, run events until one turns it on or ends the
+// scenario.  Returns false if it ended.
+bool simIdle() ;
+
+// For events: cut the power, reset the chip, power up, or end the run
+void simPowerCut() ;
+void simReset() ;
+void simPowerOn() ;
+void simDone() ;
+
+// True while a boot is running the firmware
+bool simRunning() ;
+
+// Number of boots so far
+unsigned simBoots() ;
+
+//_____________________________________________________________________
+//                                                                 PINS
+
+// Drive an input pin.  Pins left alone read HIGH, as if pulled up.
+void simInput( int pin , int level ) ;
+
+// Level the firmware last wrote to an output pin
+int simOutput( int pin ) ;
+
+// Called with every output level, bit n for GPIO n, each time one changes.
+// A power cut drops them all.
+void simOnPins( void ( * fn )( uint32_t levels ) ) ;
+
+//_____________________________________________________________________
+//                                                              NETWORK
+
+// Bring the WiFi link up or down.  It is up to start with.
+void simWifi( bool up ) ;
+
+// The loopback address of a host on the simulated network.  Host 1 is
+// the ESP.  Each run gets its own 127.x.y.0/24, so checks can run side
+// by side.
+uint32_t simAddress( int host ) ;
+
+// Resolve a name to a simulated host
+void simHost( const char * name , int host ) ;
+
+// Sockets map privileged ports up by this much, so no root is needed
+#define SIM_PORT_OFFSET 10000
+
+// Called when the firmware sends a UDP packet, from inside the boot
+void simOnSend( void ( * fn )() ) ;
+
+//_____________________________________________________________________
+//                                                                FLASH
+
+// Write or read a whole LittleFS file.  Read returns -1 if it is missing.
+void simWriteFile( const char * name , const void * data , size_t size ) ;
+long simReadFile( const char * name , void * data , size_t size ) ;
+void simRemoveFile( const char * name ) ;
+
+// Writes that reached flash since the world began
+unsigned long simFlashWrites() ;
+
+//_____________________________________________________________________
+//                                                          SERIAL PORT
+
+// Queue keys for Serial.read().  With SIM_SERIAL=1 in the environment
+// the firmware's serial output goes to stderr.
+void simType( const char * keys ) ;
+
+//_____________________________________________________________________
+//                                                        SHARED MEMORY
+
+// Zeroed memory that outlives boots.  Allocate before the first boot.
+void * simShared( size_t size ) ;
+
+// Wall-clock seconds, for throughput figures
+double simWallSeconds() ;
+
+#endif
@@ -0,0 +1,280 @@
+// WiFi.cpp
+//
+// The station, name lookups and UDP sockets on the simulated network.
+// The link itself is switched by the world with simWifi().
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <ESP8266WiFi.h>
+#include <ESP8266mDNS.h>
+#include <lwip/dns.h>
+#include "Sim.h"
+
+#define SCAN_US         2000000         // Virtual time a scan takes
+#define JOIN_US         1500000         // ... and joining a network
+#define DNS_US          30000           // ... and a name lookup
+#define MAX_LOOKUPS     8               // Lookups under way at once
+#define SIM_SSID        "wifi"          // The one network in range
+#define SIM_RSSI        -60
+
+// Kept by Sim.cpp
+bool simLinkUp() ;
+unsigned simLinkChanges() ;
+void simSent() ;
+int simLookup( const char * name ) ;
+
+ESP8266WiFiClass WiFi ;
+MDNSResponder MDNS ;
+
+//_____________________________________________________________________
+//                                                              STATION
+
+static uint64_t scanDone = 0 ;          ///< When the scan finishes, or 0 if none runs
+static int scanFound = WIFI_SCAN_FAILED ;
+
+static bool joining = false ;
+static uint64_t joinDone ;
+static unsigned joinLink ;              ///< simLinkChanges() when the join began
+
+int8_t ESP8266WiFiClass::scanNetworks( bool , bool )
+{
+        scanDone = simNow() + SCAN_US ;
+        scanFound = WIFI_SCAN_RUNNING ;
+        return WIFI_SCAN_RUNNING ;
+}
+
+int8_t ESP8266WiFiClass::scanComplete()
+{
+        if ( scanFound == WIFI_SCAN_RUNNING && simNow() >= scanDone )
+                scanFound = simLinkUp() ? 1 : 0 ;
+        return scanFound ;
+}
+
+void ESP8266WiFiClass::scanDelete() { scanFound = WIFI_SCAN_FAILED ; }
+
+String ESP8266WiFiClass::SSID( uint8_t i ) { return i < scanFound ? SIM_SSID : "" ; }
+
+int32_t ESP8266WiFiClass::RSSI( uint8_t i ) { return i < scanFound ? SIM_RSSI : 0 ; }
+
+wl_status_t ESP8266WiFiClass::begin( const char * ssid , const char * )
+{
+        joining = !strcmp( ssid , SIM_SSID ) ;
+        joinDone = simNow() + JOIN_US ;
+        joinLink = simLinkChanges() ;
+        return WL_DISCONNECTED ;
+}
+
+bool ESP8266WiFiClass::disconnect( bool )
+{
+        joining = false ;
+        return true ;
+}
+
+wl_status_t ESP8266WiFiClass::status()
+{
+        if ( !joining ) return WL_DISCONNECTED ;
+        if ( simLinkChanges() != joinLink ) {
+                // The link dropped since we joined; it takes a new join
+                joining = false ;
+                return WL_CONNECTION_LOST ;
+        }
+        if ( !simLinkUp() ) return WL_NO_SSID_AVAIL ;
+        return simNow() >= joinDone ? WL_CONNECTED : WL_DISCONNECTED ;
+}
+
+String ESP8266WiFiClass::SSID() { return status() == WL_CONNECTED ? SIM_SSID : "" ; }
+
+int32_t ESP8266WiFiClass::RSSI() { return status() == WL_CONNECTED ? SIM_RSSI : 0 ; }
+
+IPAddress ESP8266WiFiClass::localIP()
+{
+        return status() == WL_CONNECTED ? IPAddress( simAddress( 1 ) ) : IPAddress() ;
+}
+
+int ESP8266WiFiClass::hostByName( const char * name , IPAddress & ip )
+{
+        if ( status() != WL_CONNECTED ) return 0 ;
+        if ( ip.fromString( name ) ) return 1 ;
+        int host = simLookup( name ) ;
+        if ( host < 0 ) return 0 ;
+        ip = simAddress( host ) ;
+        return 1 ;
+}
+
+int ESP8266WiFiClass::hostByName( const char * name , IPAddress & ip , uint32_t )
+{
+        return hostByName( name , ip ) ;
+}
+
+//_____________________________________________________________________
+//                                                         NAME LOOKUPS
+
+// A lookup under way in this process.  Events outlive the process that
+// queued them, so each carries its pid and is dropped anywhere else.
+struct Lookup {
+        bool active ;
+        const char * name ;
+        dns_found_callback found ;
+        void * arg ;
+} ;
+
+static Lookup lookups[MAX_LOOKUPS] ;
+
+static void answerLookup( intptr_t id )
+{
+        if ( id >> 8 != getpid() ) return ;
+        auto & l = lookups[id & 0xff] ;
+        if ( !l.active ) return ;
+        l.active = false ;
+
+        IPAddress ip ;
+        ip_addr_t addr ;
+        if ( WiFi.hostByName( l.name , ip ) ) {
+                addr.addr = ip ;
+                l.found( l.name , &addr , l.arg ) ;
+        } else {
+                l.found( l.name , nullptr , l.arg ) ;
+        }
+}
+
+err_t dns_gethostbyname( const char * hostname , ip_addr_t * addr , dns_found_callback found , void * arg )
+{
+        IPAddress ip ;
+        if ( ip.fromString( hostname ) ) {
+                addr->addr = ip ;
+                return ERR_OK ;
+        }
+        for ( int i = 0 ; i < MAX_LOOKUPS ; i++ ) {
+                auto & l = lookups[i] ;
+                if ( l.active ) continue ;
+                l = { true , hostname , found , arg } ;
+                simAt( simNow() + DNS_US , answerLookup , (intptr_t) getpid() << 8 | i ) ;
+                return ERR_INPROGRESS ;
+        }
+        return ERR_MEM ;
+}
+
+bool IPAddress::fromString( const char * s )
+{
+        unsigned a , b , c , d ;
+        char end ;
+        if ( sscanf( s , "%u.%u.%u.%u%c" , &a , &b , &c , &d , &end ) != 4 ) return false ;
+        if ( a > 255 || b > 255 || c > 255 || d > 255 ) return false ;
+        *this = IPAddress( a , b , c , d ) ;
+        return true ;
+}
+
+//_____________________________________________________________________
+//                                                                  UDP
+
+static uint16_t hostPort( uint16_t port )
+{
+        return port < 1024 ? port + SIM_PORT_OFFSET : port ;
+}
+
+static uint16_t simPort( uint16_t port )
+{
+        return port >= SIM_PORT_OFFSET && port < SIM_PORT_OFFSET + 1024 ? port - SIM_PORT_OFFSET : port ;
+}
+
+uint8_t WiFiUDP::begin( uint16_t port )
+{
+        stop() ;
+        fd = socket( AF_INET , SOCK_DGRAM , 0 ) ;
+        if ( fd < 0 ) return 0 ;
+        int on = 1 ;
+        setsockopt( fd , SOL_SOCKET , SO_REUSEADDR , &on , sizeof on ) ;
+        link = simLinkChanges() ;
+
+        sockaddr_in a = {} ;
+        a.sin_family = AF_INET ;
+        a.sin_addr.s_addr = simAddress( 1 ) ;
+        a.sin_port = htons( hostPort( port ) ) ;
+        if ( bind( fd , (sockaddr *) &a , sizeof a ) < 0 ) {
+                perror( "sim: udp bind" ) ;
+                stop() ;
+                return 0 ;
+        }
+        return 1 ;
+}
+
+void WiFiUDP::stop()
+{
+        if ( fd >= 0 ) close( fd ) ;
+        fd = -1 ;
+        rxLen = rxPos = 0 ;
+        txLen = -1 ;
+}
+
+int WiFiUDP::parsePacket()
+{
+        rxLen = rxPos = 0 ;
+        if ( fd < 0 || link != simLinkChanges() ) return 0 ;
+        for ( ;; ) {
+                sockaddr_in from ;
+                socklen_t len = sizeof from ;
+                int n = recvfrom( fd , rx , sizeof rx , MSG_DONTWAIT , (sockaddr *) &from , &len ) ;
+                if ( n <= 0 ) return 0 ;
+                if ( !simLinkUp() ) continue ;          // Lost on the air
+                rxLen = n ;
+                rxFrom = from.sin_addr.s_addr ;
+                rxPort = simPort( ntohs( from.sin_port ) ) ;
+                return n ;
+        }
+}
+
+int WiFiUDP::read()
+{
+        return rxPos < rxLen ? rx[rxPos++] : -1 ;
+}
+
+int WiFiUDP::read( uint8_t * buf , size_t n )
+{
+        int got = std::min( (int) n , rxLen - rxPos ) ;
+        memcpy( buf , rx + rxPos , got ) ;
+        rxPos += got ;
+        return got ;
+}
+
+int WiFiUDP::peek()
+{
+        return rxPos < rxLen ? rx[rxPos] : -1 ;
+}
+
+int WiFiUDP::beginPacket( IPAddress ip , uint16_t port )
+{
+        txTo = ip ;
+        txPort = port ;
+        txLen = 0 ;
+        return 1 ;
+}
+
+size_t WiFiUDP::write( uint8_t c ) { return write( &c , 1 ) ; }
+
+size_t WiFiUDP::write( const uint8_t * buf , size_t n )
+{
+        if ( txLen < 0 ) return 0 ;
+        n = std::min( n , sizeof tx - txLen ) ;
+        memcpy( tx + txLen , buf , n ) ;
+        txLen += n ;
+        return n ;
+}
+
+int WiFiUDP::endPacket()
+{
+        int len = txLen ;
+        txLen = -1 ;
+        if ( fd < 0 || len < 0 || link != simLinkChanges() ) return 0 ;
+        if ( !simLinkUp() ) return 1 ;          // Sent into the void
+
+        sockaddr_in a = {} ;
+        a.sin_family = AF_INET ;
+        a.sin_addr.s_addr = txTo ;
+        a.sin_port = htons( hostPort( txPort ) ) ;
+        if ( sendto( fd , tx , len , 0 , (sockaddr *) &a , sizeof a ) != len ) return 0 ;
+        simSent() ;
+        return 1 ;
+}
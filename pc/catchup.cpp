@@ -0,0 +1,119 @@
+// catchup.cpp
+//
+// How long planCatchUp() takes to bring a wrong face right
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Each second is decided the way markTime() decides it, and the face
+// moved with the protocol's own model in Protocol.h.  The face starts
+// `offset` minutes wrong at START_TIME, and is right once it shows the
+// minute of real time and stays there.
+//
+//    catchup                           check every offset at a few timings
+//    catchup <rise> <fall> [offset...] print the time for each offset, in
+//                                      minutes the face is fast (+) or
+//                                      slow (-); every one if none given
+//
+// The check fails if a face comes right more than SLACK seconds before or
+// after the plan said it would.  Going wrong again afterwards counts as
+// coming right late.
+
+#include <Arduino.h>
+#include "Config.h"
+#include "Face.h"
+
+#define FACES           ( MAX_TIME / 60 )
+#define START_TIME      ( ( 10 * 60 + 20 ) * 60 + 30 )  // 10:20:30
+#define SETTLE          ( 2 * 60 * 60 )                 // Stay right this long after
+#define SLACK           5                               // Seconds the plan may be out
+
+struct Correction {
+        unsigned long planned ;         ///< Seconds the first plan expected
+        unsigned long took ;            ///< Seconds until the face was right for good
+        bool wait ;                     ///< The first plan waited
+        bool ride ;                     ///< The first plan rode the schedule
+} ;
+
+//_____________________________________________________________________
+//                                                                 MODEL
+
+// Run the face from `offset` minutes wrong until it has been right for
+// SETTLE seconds
+static Correction correct( int offset )
+{
+        unsigned face = ( START_TIME / 60 + FACES + offset % FACES ) % FACES ;
+        Correction c = { 0 , 0 , false , false } ;
+        unsigned long sent = 0 ;
+
+        for ( unsigned long n = 0 ; n <= c.took + SETTLE ; n++ ) {
+                unsigned now = ( START_TIME + n ) % MAX_TIME ;
+                auto plan = planCatchUp( face , now ) ;
+                if ( !n ) {
+                        c.planned = plan.seconds ;
+                        c.wait = plan.wait ;
+                        c.ride = plan.ride ;
+                }
+                face = markFace( face , now , plan , &sent ) ;
+                if ( face != now / 60 ) c.took = n + 1 ;
+        }
+        return c ;
+}
+
+//_____________________________________________________________________
+//                                                                 MAIN
+
+static void printOne( int offset )
+{
+        auto c = correct( offset ) ;
+        printf( "%+5d min  %-4s %6lus planned %6lus\n" , offset ,
+                c.wait ? "wait" : c.ride ? "ride" : "run" , c.took , c.planned ) ;
+}
+
+// Check every wrong face at one pulse timing
+static bool checkTiming( unsigned rise , unsigned fall )
+{
+        setPulseTiming( rise , fall ) ;
+
+        unsigned bad = 0 ;
+        unsigned long worst = 0 , total = 0 ;
+        int worstAt = 0 ;
+        for ( int offset = -FACES / 2 + 1 ; offset <= FACES / 2 ; offset++ ) {
+                if ( !offset ) continue ;
+                auto c = correct( offset ) ;
+                total += c.took ;
+                if ( c.took > worst ) {
+                        worst = c.took ;
+                        worstAt = offset ;
+                }
+                long off = (long) c.took - (long) c.planned ;
+                if ( ( off > SLACK || off < -SLACK ) && bad++ < 10 )
+                        printf( "  %+d min: right after %lus, planned %lus\n" , offset , c.took , c.planned ) ;
+        }
+        printf( "%4ums on %4ums off  %2u a second  mean %5lus  worst %5lus at %+d min  %s\n" ,
+                rise , fall , pulsesPerSecond() , total / ( FACES - 1 ) , worst , worstAt , bad ? "FAIL" : "PASS" ) ;
+        return !bad ;
+}
+
+int main( int argc , char ** argv )
+{
+        if ( argc >= 3 ) {
+                if ( !setPulseTiming( atoi( argv[1] ) , atoi( argv[2] ) ) ) {
+                        fprintf( stderr , "The movement can't be driven %sms on, %sms off\n" , argv[1] , argv[2] ) ;
+                        return 2 ;
+                }
+                if ( argc > 3 ) {
+                        for ( int i = 3 ; i < argc ; i++ ) printOne( atoi( argv[i] ) ) ;
+                } else {
+                        for ( int offset = -FACES / 2 + 1 ; offset <= FACES / 2 ; offset++ ) printOne( offset ) ;
+                }
+                return 0 ;
+        }
+
+        bool ok = checkTiming( ClockProtocol::Policy::riseMs , ClockProtocol::Policy::fallMs ) ;
+        ok &= checkTiming( 100 , 100 ) ;
+        ok &= checkTiming( 50 , 50 ) ;
+        return ok ? 0 : 1 ;
+}
@@ -0,0 +1,101 @@
+// civil.cpp
+//
+// TimeService::localtime() against the C library, every second of a
+// year, and how fast each one is
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// localtime() caches the UTC offset until the next DST transition and
+// otherwise works from time() with integer arithmetic.  For each zone
+// below the system clock is set once, just before YEAR_START, and then
+// runs a second at a time for a whole year; at every second the cached
+// answer must match the seconds of the day ::localtime() gives.  The
+// zones cover both hemispheres, a half-hour offset and a half-hour DST
+// change.
+//
+// Then both ways are timed at one moment, the cached one as the clock
+// loop calls it, and the libc one as it was before the cache.
+
+#include <Arduino.h>
+#include "TimeService.h"
+#include "Sim.h"
+
+#define YEAR_START      1767225600L     // 2026-01-01 00:00:00 UTC
+#define YEAR            ( 365 * 86400L )
+#define CALLS           2000000         // Calls timed each way
+
+static const char * const zones[] = {
+        "PST8PDT,M3.2.0,M11.1.0" ,              // The sketch's own
+        "GMT0BST,M3.5.0/1,M10.5.0" ,
+        "AEST-10AEDT,M10.1.0,M4.1.0/3" ,        // DST over new year
+        "IST-5:30" ,                            // No DST
+        "LHST-10:30LHDT-11,M10.1.0,M4.1.0" ,    // DST is half an hour
+} ;
+
+// Seconds since local midnight the way localtime() worked before
+static time_t libcLocal( time_t t )
+{
+        struct tm lt = *::localtime( &t ) ;
+        return lt.tm_hour * 3600L + lt.tm_min * 60L + lt.tm_sec ;
+}
+
+// Run a year in one zone; returns the seconds that differ
+static unsigned long checkZone( const char * tz )
+{
+        setenv( "TZ" , tz , 1 ) ;
+        tzset() ;
+
+        TimeService ts ;
+        ts.setTime( YEAR_START - 1 ) ;
+
+        unsigned long bad = 0 ;
+        unsigned transitions = 0 ;
+        int wasDst = -1 ;
+        for ( long n = 0 ; n < YEAR ; n++ ) {
+                simSpend( 1000000 ) ;
+                time_t now = YEAR_START + n ;
+                time_t got = TimeService::localtime() ;
+
+                // The reentrant call skips ::localtime()'s TZ check, which
+                // would take most of the run
+                struct tm lt ;
+                localtime_r( &now , &lt ) ;
+                time_t want = lt.tm_hour * 3600L + lt.tm_min * 60L + lt.tm_sec ;
+                if ( got != want && bad++ < 5 )
+                        printf( "  %s at %ld: %ld, libc says %ld\n" , tz , (long) now , (long) got , (long) want ) ;
+                if ( n && lt.tm_isdst != wasDst ) ++transitions ;
+                wasDst = lt.tm_isdst ;
+        }
+        printf( "  %-34s %u transitions  %lu seconds differ\n" , tz , transitions , bad ) ;
+        return bad ;
+}
+
+int main()
+{
+        setvbuf( stdout , nullptr , _IOLBF , 0 ) ;
+        TimeService::begin() ;
+
+        unsigned long bad = 0 ;
+        for ( auto tz : zones ) bad += checkZone( tz ) ;
+
+        // Time both at one moment, in the sketch's zone
+        setenv( "TZ" , zones[0] , 1 ) ;
+        tzset() ;
+        volatile time_t sink = 0 ;
+
+        double wall = simWallSeconds() ;
+        for ( long i = 0 ; i < CALLS ; i++ ) sink = sink + TimeService::localtime() ;
+        double cached = simWallSeconds() - wall ;
+
+        wall = simWallSeconds() ;
+        for ( long i = 0 ; i < CALLS ; i++ ) sink = sink + libcLocal( time( nullptr ) ) ;
+        double libc = simWallSeconds() - wall ;
+
+        printf( "cached  %6.1f M calls/s\n" , CALLS / cached / 1e6 ) ;
+        printf( "libc    %6.1f M calls/s\n" , CALLS / libc / 1e6 ) ;
+        printf( "%s\n" , bad ? "FAIL" : "PASS" ) ;
+        return bad ? 1 : 0 ;
+}
@@ -0,0 +1,148 @@
+// hourly.cpp
+//
+// Small corrections: the catch-up planner against the protocol's own
+// hourly correction
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// An IBM face a few minutes out comes right by itself within the hour:
+// a fast one parks at :59 until the top of the hour, and the A burst in
+// minute 59 pulls a slow one in :49-:58 up to :59.  That needs no pulse
+// beyond the schedule, but the face stays wrong until it happens.  The
+// planner rides the burst when it brings the face right within the
+// minute, and runs or waits otherwise.
+//
+// For each offset up to MAX_OFFSET minutes, and a start every STRIDE
+// seconds through the hour, a face is run for HORIZON seconds three
+// ways: as markTime() runs it with the planner, with the planner as it
+// was before it could ride, and on the bare schedule.  It counts the
+// seconds each shows the wrong minute and the pulses each sends.  A
+// second movement on the same lines starts right; catch-up pulses step
+// it too, and the seconds that leaves it wrong are counted.
+//
+// The check fails if the bare schedule is ever right for more seconds
+// than the planner, or the planner leaves a face wrong.  Where the
+// planner rides, it must leave the other movement wrong for no longer
+// than running would, and take less than a minute longer itself.  A
+// face that has to run into the burst's reach first knocks the other
+// movement just the same.
+
+#include <Arduino.h>
+#include "Face.h"
+
+#define MAX_OFFSET      10              // Minutes fast or slow
+#define STRIDE          10              // Seconds between starts
+#define START_HOUR      10
+#define HORIZON         ( 2 * 60 * 60 )
+
+enum Mode {
+        PLANNER ,                       ///< As markTime() plans
+        RUNNING ,                       ///< The planner without riding
+        HOURLY ,                        ///< The schedule alone
+        MODES
+} ;
+
+struct Run {
+        unsigned long wrong ;           ///< Seconds showing the wrong minute
+        unsigned long sent ;            ///< Pulses on the lines
+        unsigned long knocked ;         ///< Seconds the other movement is wrong
+        bool rode ;                     ///< The plan rode the schedule at some point
+        bool right ;                    ///< Right at the end
+} ;
+
+// Run a face `offset` minutes wrong from `start` for HORIZON seconds
+static Run run( int offset , unsigned start , Mode mode )
+{
+        const unsigned faces = MAX_TIME / 60 ;
+        unsigned face = ( start / 60 + faces + offset ) % faces ;
+        unsigned other = ( MAX_TIME + start - 1 ) % MAX_TIME / 60 ;    // Right the second before
+        const CatchUpPlan onTime = { false , false , 0 , 0 } ;
+        Run r = { 0 , 0 , 0 , false , false } ;
+
+        for ( unsigned n = 0 ; n < HORIZON ; n++ ) {
+                unsigned now = ( start + n ) % MAX_TIME ;
+                auto plan = mode == PLANNER ? planCatchUp( face , now )
+                          : mode == RUNNING ? planCatchUp( faceDelta( face , now ) ) : onTime ;
+                r.rode |= plan.ride ;
+                face = markFace( face , now , plan , &r.sent , &other ) ;
+                r.right = face == now / 60 ;
+                if ( !r.right ) ++r.wrong ;
+                if ( other != now / 60 ) ++r.knocked ;
+        }
+        return r ;
+}
+
+// Per offset, over every start
+struct Totals {
+        unsigned long wrong[MODES] , worst[MODES] , sent[MODES] ;
+        unsigned unfixed ;              ///< Starts the schedule alone never fixed
+        unsigned rides ;                ///< Starts where the planner rode
+        unsigned long rideWrong[2] , rideKnocked[2] ;   ///< Over those, PLANNER and RUNNING
+} ;
+
+int main()
+{
+        const unsigned starts = 60 * 60 / STRIDE ;
+        Totals totals[2 * MAX_OFFSET + 1] = {} ;
+        unsigned bad = 0 ;
+
+        for ( int offset = -MAX_OFFSET ; offset <= MAX_OFFSET ; offset++ ) {
+                if ( !offset ) continue ;
+                auto & t = totals[offset + MAX_OFFSET] ;
+
+                for ( unsigned i = 0 ; i < starts ; i++ ) {
+                        unsigned start = START_HOUR * 60 * 60 + i * STRIDE ;
+                        Run r[MODES] ;
+                        for ( int m = 0 ; m < MODES ; m++ ) {
+                                r[m] = run( offset , start , (Mode) m ) ;
+                                t.wrong[m] += r[m].wrong ;
+                                t.sent[m] += r[m].sent ;
+                                if ( r[m].wrong > t.worst[m] ) t.worst[m] = r[m].wrong ;
+                        }
+                        if ( !r[HOURLY].right ) ++t.unfixed ;
+                        if ( ( !r[PLANNER].right || r[PLANNER].wrong > r[HOURLY].wrong ) && bad++ < 10 )
+                                printf( "  %+d min from %u: planner wrong %lus, hourly only %lus\n" ,
+                                        offset , start , r[PLANNER].wrong , r[HOURLY].wrong ) ;
+                        if ( !r[PLANNER].rode ) continue ;
+
+                        ++t.rides ;
+                        for ( int m = 0 ; m < 2 ; m++ ) {
+                                t.rideWrong[m] += r[m].wrong ;
+                                t.rideKnocked[m] += r[m].knocked ;
+                        }
+                        if ( ( r[PLANNER].knocked > r[RUNNING].knocked ||
+                               r[PLANNER].wrong >= r[RUNNING].wrong + 60 ) && bad++ < 10 )
+                                printf( "  %+d min from %u: riding wrong %lus, other %lus; running %lus, other %lus\n" ,
+                                        offset , start , r[PLANNER].wrong , r[PLANNER].knocked ,
+                                        r[RUNNING].wrong , r[RUNNING].knocked ) ;
+                }
+        }
+
+        printf( "%s protocol, %u starts an hour, %us each\n" , ClockProtocol::Policy::name , starts , HORIZON ) ;
+        printf( "         wrong seconds, mean (worst)          pulses, mean\n" ) ;
+        printf( "offset   planner          hourly only        planner  hourly only\n" ) ;
+        for ( int offset = -MAX_OFFSET ; offset <= MAX_OFFSET ; offset++ ) {
+                if ( !offset ) continue ;
+                auto & t = totals[offset + MAX_OFFSET] ;
+                printf( "%+4d min %6lus (%5lus)   " , offset , t.wrong[PLANNER] / starts , t.worst[PLANNER] ) ;
+                if ( t.unfixed ) printf( "never right %3u%%  " , t.unfixed * 100 / starts ) ;
+                else printf( "%6lus (%5lus)   " , t.wrong[HOURLY] / starts , t.worst[HOURLY] ) ;
+                printf( "%7lu  %7lu\n" , t.sent[PLANNER] / starts , t.sent[HOURLY] / starts ) ;
+        }
+
+        printf( "\nStarts that ride the burst, against running: mean seconds wrong\n" ) ;
+        printf( "offset   starts   riding   running   other movement riding   running\n" ) ;
+        for ( int offset = -MAX_OFFSET ; offset <= MAX_OFFSET ; offset++ ) {
+                auto & t = totals[offset + MAX_OFFSET] ;
+                if ( !t.rides ) continue ;
+                printf( "%+4d min %6u  %6lus   %6lus                 %6lus   %6lus\n" , offset , t.rides ,
+                        t.rideWrong[PLANNER] / t.rides , t.rideWrong[RUNNING] / t.rides ,
+                        t.rideKnocked[PLANNER] / t.rides , t.rideKnocked[RUNNING] / t.rides ) ;
+        }
+
+        printf( "%s\n" , bad ? "FAIL" : "PASS" ) ;
+        return bad ? 1 : 0 ;
+}
@@ -0,0 +1,192 @@
+// Arduino.h
+//
+// Host stand-in for the ESP8266 Arduino core
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Just the parts of the core the master_clock sources use.  IRAM and
+// PROGMEM placement mean nothing here.  Time, pins, timer1, RTC memory
+// and the serial port are modelled in Sim.cpp.
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <ctype.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+
+#define HIGH            1
+#define LOW             0
+
+#define INPUT           0x00
+#define INPUT_PULLUP    0x02
+#define OUTPUT          0x01
+
+#define RISING          1
+#define FALLING         2
+#define CHANGE          3
+
+// NodeMCU pin names
+#define D0              16
+#define D1              5
+#define D2              4
+#define D3              0
+#define D4              2
+#define D5              14
+#define D6              12
+#define D7              13
+#define D8              15
+
+#define LED_BUILTIN     2
+#define BUILTIN_LED     2
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+#define F( s )          ( s )
+#define pgm_read_byte( a )      ( *(const uint8_t *) ( a ) )
+#define pgm_read_word( a )      ( *(const uint16_t *) ( a ) )
+#define pgm_read_dword( a )     ( *(const uint32_t *) ( a ) )
+
+#define digitalPinToInterrupt( p )      ( p )
+
+typedef bool boolean ;
+typedef uint8_t byte ;
+
+unsigned long millis() ;
+unsigned long micros() ;
+void delay( unsigned long ms ) ;
+void yield() ;
+
+void pinMode( uint8_t pin , uint8_t mode ) ;
+void digitalWrite( uint8_t pin , uint8_t level ) ;
+int digitalRead( uint8_t pin ) ;
+void attachInterrupt( uint8_t pin , void ( * isr )() , int mode ) ;
+void detachInterrupt( uint8_t pin ) ;
+
+// Interrupts only ever run between firmware statements that wait, so
+// there is nothing to mask
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+//_____________________________________________________________________
+//                                                              STRINGS
+
+class String {
+public:
+        String() {}
+        String( const char * s ) : s( s ? s : "" ) {}
+        const char * c_str() const { return s.c_str() ; }
+        unsigned length() const { return s.size() ; }
+        bool operator==( const char * other ) const { return s == other ; }
+private:
+        std::string s ;
+} ;
+
+class Printable ;
+
+class Print {
+public:
+        virtual ~Print() {}
+        virtual size_t write( uint8_t c ) = 0 ;
+        virtual size_t write( const uint8_t * buf , size_t n ) ;
+        size_t write( const char * s ) { return write( (const uint8_t *) s , strlen( s ) ) ; }
+        virtual int availableForWrite() { return 0 ; }
+
+        size_t print( const char * s ) { return write( s ) ; }
+        size_t print( const String & s ) { return write( s.c_str() ) ; }
+        size_t print( char c ) { return write( (uint8_t) c ) ; }
+        size_t print( int n ) { return printf( "%d" , n ) ; }
+        size_t print( unsigned n ) { return printf( "%u" , n ) ; }
+        size_t print( long n ) { return printf( "%ld" , n ) ; }
+        size_t print( unsigned long n ) { return printf( "%lu" , n ) ; }
+        size_t println() { return write( "\r\n" ) ; }
+        template < class T > size_t println( const T & v ) { return print( v ) + println() ; }
+        size_t printf( const char * format , ... ) __attribute__(( format( printf , 2 , 3 ) )) ;
+        void flush() {}
+} ;
+
+class Stream : public Print {
+public:
+        virtual int available() = 0 ;
+        virtual int read() = 0 ;
+        virtual int peek() = 0 ;
+
+        // Skip to the next number and read it; 0 if there is none
+        long parseInt() ;
+} ;
+
+class HardwareSerial : public Stream {
+public:
+        void begin( unsigned long ) {}
+        size_t write( uint8_t c ) override ;
+        size_t write( const uint8_t * buf , size_t n ) override ;
+        using Print::write ;
+        int availableForWrite() override { return 256 ; }
+        int available() override ;
+        int read() override ;
+        int peek() override ;
+} ;
+
+extern HardwareSerial Serial ;
+
+//_____________________________________________________________________
+//                                                                  ESP
+
+class EspClass {
+public:
+        uint32_t getCycleCount() ;
+        uint8_t getCpuFreqMHz() { return 80 ; }
+        uint32_t getFreeHeap() { return 40000 ; }
+        uint32_t getChipId() { return 0x00c10c ; }
+        bool rtcUserMemoryRead( uint32_t offset , uint32_t * data , size_t size ) ;
+        bool rtcUserMemoryWrite( uint32_t offset , uint32_t * data , size_t size ) ;
+        void restart() ;
+} ;
+
+extern EspClass ESP ;
+
+//_____________________________________________________________________
+//                                                               TIMER1
+
+#define TIM_DIV1        0       // 80MHz, 80 ticks per us
+#define TIM_DIV16       1       // 5MHz, 5 ticks per us
+#define TIM_DIV256      3       // 312.5KHz
+#define TIM_EDGE        0
+#define TIM_LEVEL       1
+#define TIM_SINGLE      0
+#define TIM_LOOP        1
+
+typedef void ( * timercallback )( void ) ;
+
+void timer1_attachInterrupt( timercallback isr ) ;
+void timer1_detachInterrupt() ;
+void timer1_enable( uint8_t divider , uint8_t intType , uint8_t reload ) ;
+void timer1_write( uint32_t ticks ) ;
+void timer1_disable() ;
+
+//_____________________________________________________________________
+//                                                       GPIO REGISTERS
+
+// GPO holds the levels of GPIO0-15.  Writing GPOS sets bits and GPOC
+// clears them, as on the chip.  Every write reaches Sim.cpp, which tells
+// the world the new levels.
+struct SimGpio {
+        enum Kind { OUT , SET , CLEAR } kind ;
+        SimGpio & operator=( uint32_t value ) ;
+        operator uint32_t() const ;
+} ;
+
+extern SimGpio GPO , GPOS , GPOC ;
+
+#endif
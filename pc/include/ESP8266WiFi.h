@@ -0,0 +1,60 @@
+// ESP8266WiFi.h
+//
+// Host stand-in for the ESP8266 WiFi station
+//
+// The link, the scan results and name lookups come from the simulated
+// network in Sim.cpp.  A scan finds the networks named in the sketch; a
+// join takes a second or two of virtual time.
+
+#ifndef ESP8266WIFI_H
+#define ESP8266WIFI_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+#include "WiFiUdp.h"
+
+typedef enum {
+        WL_IDLE_STATUS = 0 ,
+        WL_NO_SSID_AVAIL = 1 ,
+        WL_SCAN_COMPLETED = 2 ,
+        WL_CONNECTED = 3 ,
+        WL_CONNECT_FAILED = 4 ,
+        WL_CONNECTION_LOST = 5 ,
+        WL_WRONG_PASSWORD = 6 ,
+        WL_DISCONNECTED = 7 ,
+} wl_status_t ;
+
+typedef enum { WIFI_OFF = 0 , WIFI_STA = 1 , WIFI_AP = 2 , WIFI_AP_STA = 3 } WiFiMode_t ;
+
+#define WIFI_SCAN_RUNNING       ( -1 )
+#define WIFI_SCAN_FAILED        ( -2 )
+
+class ESP8266WiFiClass {
+public:
+        bool persistent( bool ) { return true ; }
+        bool mode( WiFiMode_t ) { return true ; }
+        bool hostname( const char * ) { return true ; }
+        bool setAutoReconnect( bool ) { return true ; }
+
+        int8_t scanNetworks( bool async = false , bool hidden = false ) ;
+        int8_t scanComplete() ;
+        void scanDelete() ;
+        String SSID( uint8_t i ) ;
+        int32_t RSSI( uint8_t i ) ;
+
+        wl_status_t begin( const char * ssid , const char * pass ) ;
+        bool disconnect( bool wifioff = false ) ;
+        wl_status_t status() ;
+        String SSID() ;
+        int32_t RSSI() ;
+        IPAddress localIP() ;
+
+        int hostByName( const char * name , IPAddress & ip ) ;
+        int hostByName( const char * name , IPAddress & ip , uint32_t timeoutMs ) ;
+} ;
+
+extern ESP8266WiFiClass WiFi ;
+
+#endif
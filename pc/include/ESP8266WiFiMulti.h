@@ -0,0 +1,5 @@
+// ESP8266WiFiMulti.h
+//
+// Host stand-in; the sketch does its own network selection
+
+#include "ESP8266WiFi.h"
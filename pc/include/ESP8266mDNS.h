@@ -0,0 +1,20 @@
+// ESP8266mDNS.h
+//
+// Host stand-in for the mDNS responder, which answers nobody here
+
+#ifndef ESP8266MDNS_H
+#define ESP8266MDNS_H
+
+#include "ESP8266WiFi.h"
+
+class MDNSResponder {
+public:
+        bool begin( const char * ) { return true ; }
+        void end() {}
+        void update() {}
+        bool addService( const char * , const char * , uint16_t ) { return true ; }
+} ;
+
+extern MDNSResponder MDNS ;
+
+#endif
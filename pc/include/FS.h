@@ -0,0 +1,61 @@
+// FS.h
+//
+// Host stand-in for the ESP8266 core's filesystem classes
+//
+// Files live in the simulated flash in Sim's shared memory, so they
+// survive power cuts.  Only whole-file names are supported; there are no
+// directories.
+
+#ifndef FS_H
+#define FS_H
+
+#include "Arduino.h"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0 , SeekCur = 1 , SeekEnd = 2 } ;
+
+class File : public Stream {
+public:
+        File() {}
+        File( int index , bool writable ) : index( index ) , writable( writable ) {}
+        explicit operator bool() const { return index >= 0 ; }
+
+        size_t write( uint8_t c ) override { return write( &c , 1 ) ; }
+        size_t write( const uint8_t * buf , size_t n ) override ;
+        using Print::write ;
+        int available() override ;
+        int read() override ;
+        size_t read( uint8_t * buf , size_t n ) ;
+        int peek() override ;
+        bool seek( uint32_t pos , SeekMode mode = SeekSet ) ;
+        size_t position() const { return pos ; }
+        size_t size() const ;
+        bool truncate( uint32_t size ) ;
+        void flush() {}
+        void close() { index = -1 ; }
+
+private:
+        int index = -1 ;        ///< Slot in the simulated flash
+        bool writable = false ;
+        size_t pos = 0 ;
+} ;
+
+class FS {
+public:
+        bool begin() ;
+        void end() {}
+        File open( const char * path , const char * mode ) ;
+        bool exists( const char * path ) ;
+        bool remove( const char * path ) ;
+} ;
+
+}
+
+using fs::File ;
+using fs::FS ;
+using fs::SeekSet ;
+using fs::SeekCur ;
+using fs::SeekEnd ;
+
+#endif
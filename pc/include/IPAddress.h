@@ -0,0 +1,31 @@
+// IPAddress.h
+//
+// Host stand-in for the ESP8266 core's IPv4 address
+//
+// The address is kept in network byte order, so the first octet is the
+// low byte of the uint32_t, as on the ESP.
+
+#ifndef IPADDRESS_H
+#define IPADDRESS_H
+
+#include <stdint.h>
+
+class IPAddress {
+public:
+        IPAddress() : addr( 0 ) {}
+        IPAddress( uint32_t addr ) : addr( addr ) {}
+        IPAddress( uint8_t a , uint8_t b , uint8_t c , uint8_t d )
+                : addr( a | b << 8 | c << 16 | (uint32_t) d << 24 ) {}
+        operator uint32_t() const { return addr ; }
+        uint8_t operator[]( int i ) const { return addr >> ( 8 * i ) ; }
+        bool operator==( const IPAddress & o ) const { return addr == o.addr ; }
+        bool operator!=( const IPAddress & o ) const { return addr != o.addr ; }
+        bool isSet() const { return addr != 0 ; }
+
+        // Parse a dotted quad; false if it isn't one
+        bool fromString( const char * s ) ;
+private:
+        uint32_t addr ;
+} ;
+
+#endif
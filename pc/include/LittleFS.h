@@ -0,0 +1,12 @@
+// LittleFS.h
+//
+// Host stand-in for the LittleFS mount; see FS.h
+
+#ifndef LITTLEFS_H
+#define LITTLEFS_H
+
+#include "FS.h"
+
+extern fs::FS LittleFS ;
+
+#endif
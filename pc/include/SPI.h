@@ -0,0 +1,3 @@
+// SPI.h
+//
+// Host stand-in; the sketch includes it but drives no SPI devices
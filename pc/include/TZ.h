@@ -0,0 +1,15 @@
+// TZ.h
+//
+// Host stand-in for the ESP8266 core's POSIX time zone strings, for the
+// zones the sketch names
+
+#ifndef TZ_H
+#define TZ_H
+
+#define TZ_America_Los_Angeles  "PST8PDT,M3.2.0,M11.1.0"
+#define TZ_America_Detroit      "EST5EDT,M3.2.0,M11.1.0"
+#define TZ_America_Chicago      "CST6CDT,M3.2.0,M11.1.0"
+#define TZ_Europe_London        "GMT0BST,M3.5.0/1,M10.5.0"
+#define TZ_Australia_Sydney     "AEST-10AEDT,M10.1.0,M4.1.0/3"
+
+#endif
@@ -0,0 +1,31 @@
+// WiFiClient.h
+//
+// Host stand-in for the ESP8266 core's TCP client
+//
+// The simulated network has no TCP peers, so a client is never connected.
+
+#ifndef WIFICLIENT_H
+#define WIFICLIENT_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+class WiFiClient : public Stream {
+public:
+        explicit operator bool() const { return false ; }
+        bool connected() { return false ; }
+        void stop() {}
+        bool stop( unsigned int ) { return true ; }
+        void abort() {}
+        void setNoDelay( bool ) {}
+        IPAddress remoteIP() { return IPAddress() ; }
+        size_t write( uint8_t ) override { return 0 ; }
+        size_t write( const uint8_t * , size_t ) override { return 0 ; }
+        using Print::write ;
+        int availableForWrite() override { return 0 ; }
+        int available() override { return 0 ; }
+        int read() override { return -1 ; }
+        int peek() override { return -1 ; }
+} ;
+
+#endif
@@ -0,0 +1,5 @@
+// WiFiClientSecure.h
+//
+// Host stand-in; the sketch includes it but makes no TLS connections
+
+#include "WiFiClient.h"
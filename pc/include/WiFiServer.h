@@ -0,0 +1,23 @@
+// WiFiServer.h
+//
+// Host stand-in for the ESP8266 core's TCP server.  Nobody connects.
+
+#ifndef WIFISERVER_H
+#define WIFISERVER_H
+
+#include "WiFiClient.h"
+
+class WiFiServer {
+public:
+        WiFiServer( uint16_t port ) : port( port ) {}
+        void begin() {}
+        void stop() {}
+        void setNoDelay( bool ) {}
+        bool hasClient() { return false ; }
+        WiFiClient available() { return WiFiClient() ; }
+        WiFiClient accept() { return WiFiClient() ; }
+private:
+        uint16_t port ;
+} ;
+
+#endif
@@ -0,0 +1,58 @@
+// WiFiUdp.h
+//
+// Host stand-in for the ESP8266 core's UDP socket
+//
+// A real non-blocking socket on the simulated network's loopback
+// addresses, so NTP can be tested against stand-in servers.  Privileged
+// ports are moved up by SIM_PORT_OFFSET.  Nothing goes out while the
+// simulated WiFi link is down, and a socket bound before the link last
+// changed is dead until begin() is called again.
+
+#ifndef WIFIUDP_H
+#define WIFIUDP_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+class WiFiUDP : public Stream {
+public:
+        WiFiUDP() {}
+        ~WiFiUDP() { stop() ; }
+        WiFiUDP( const WiFiUDP & ) = delete ;
+        WiFiUDP & operator=( const WiFiUDP & ) = delete ;
+
+        uint8_t begin( uint16_t port ) ;
+        void stop() ;
+
+        // Receiving: take the next datagram, then read it
+        int parsePacket() ;
+        int available() override { return rxLen - rxPos ; }
+        int read() override ;
+        int read( uint8_t * buf , size_t n ) ;
+        int read( char * buf , size_t n ) { return read( (uint8_t *) buf , n ) ; }
+        int peek() override ;
+        void flush() { rxPos = rxLen ; }
+        IPAddress remoteIP() { return rxFrom ; }
+        uint16_t remotePort() { return rxPort ; }
+
+        // Sending: build a datagram, then send it
+        int beginPacket( IPAddress ip , uint16_t port ) ;
+        size_t write( uint8_t c ) override ;
+        size_t write( const uint8_t * buf , size_t n ) override ;
+        using Print::write ;
+        int endPacket() ;
+
+private:
+        int fd = -1 ;
+        unsigned link = 0 ;     ///< simLinkChanges() when it was bound
+        uint8_t rx[1500] ;
+        int rxLen = 0 , rxPos = 0 ;
+        IPAddress rxFrom ;
+        uint16_t rxPort = 0 ;
+        uint8_t tx[1500] ;
+        int txLen = -1 ;        ///< -1 outside beginPacket()/endPacket()
+        IPAddress txTo ;
+        uint16_t txPort = 0 ;
+} ;
+
+#endif
@@ -0,0 +1,35 @@
+// coredecls.h
+//
+// Host stand-in for the ESP8266 core's scheduling and clock hooks
+//
+// esp_delay() sleeps in virtual time until the timeout, or until an
+// interrupt handler calls esp_schedule() and the condition clears.
+
+#ifndef COREDECLS_H
+#define COREDECLS_H
+
+#include <stdint.h>
+#include <sys/time.h>
+
+// Called after every settimeofday()
+void settimeofday_cb( void ( * cb )() ) ;
+
+void esp_schedule() ;
+
+// Run virtual time on towards `until`, stopping after the first
+// interrupt or event.  Returns false once `until` is reached.
+bool simStep( uint64_t until ) ;
+uint64_t simNow() ;
+
+template < typename T >
+inline void esp_delay( const uint32_t ms , T && blocked ) {
+        uint64_t until = simNow() + ms * 1000ULL ;
+        while ( blocked() && simStep( until ) ) ;
+}
+
+inline void esp_delay( const uint32_t ms ) {
+        uint64_t until = simNow() + ms * 1000ULL ;
+        while ( simStep( until ) ) ;
+}
+
+#endif
@@ -0,0 +1,34 @@
+// lwip/dns.h
+//
+// Host stand-in for lwIP's non-blocking name lookup
+//
+// A dotted quad is answered at once.  Any other name is answered through
+// the callback a little later in virtual time, from the simulated
+// network's host table, or with nullptr if it is not there or the link
+// is down.  As on the ESP, the callback runs between pieces of firmware
+// code, never inside one.
+
+#ifndef LWIP_DNS_H
+#define LWIP_DNS_H
+
+#include <stdint.h>
+
+typedef int8_t err_t ;
+
+#define ERR_OK          0
+#define ERR_MEM         ( -1 )
+#define ERR_INPROGRESS  ( -5 )
+#define ERR_ARG         ( -16 )
+
+// An IPv4 address in network byte order, as lwIP builds it without IPv6
+struct ip_addr_t {
+        uint32_t addr ;
+} ;
+
+#define ip_addr_get_ip4_u32( ipaddr ) ( ( ipaddr )->addr )
+
+typedef void ( * dns_found_callback )( const char * name , const ip_addr_t * ipaddr , void * arg ) ;
+
+err_t dns_gethostbyname( const char * hostname , ip_addr_t * addr , dns_found_callback found , void * arg ) ;
+
+#endif
@@ -0,0 +1,304 @@
+// ntp.cpp
+//
+// The SNTP client against stand-in servers on real UDP sockets
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Three stand-ins run for the whole program; each case sets how they
+// behave and runs a fresh client against them in its own process, as
+// after a boot.  The client's clock is compared with the world's
+// reference UTC.
+//
+// The first poll after a boot finds the clock at 1970, so the offset is
+// far beyond a 32-bit long in microseconds, as the ESP's long is.  The
+// host's long is 64 bits wide and would hide a cut, so the types are
+// checked at build time.
+//
+// Servers that send kiss-of-death, are unsynchronized, answer someone
+// else's query or take too long must be ignored, even with their clock
+// far off.  The server with the shortest round trip must win.  A small
+// reference step must be slewed out no faster than SLEW_US a second,
+// and a large one stepped.
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include "NtpClient.h"
+#include "NtpServer.h"
+#include "NtpStandIn.h"
+#include "Sim.h"
+
+#define UTC_START       1767225600L     // 2026-01-01 00:00:00 UTC
+#define SLEW_US         500             // As NtpClient.cpp
+#define SLEW_SLACK_US   100             // Drift correction on top
+#define SYNCED_US       1000            // Right to within this
+#define FAR_US          10000000        // A badly wrong server clock
+
+static const char * const names[] = { "ntp-a" , "ntp-b" , "ntp-c" } ;
+#define SERVERS         3
+
+static NtpStandIn * stand[SERVERS] ;
+
+static_assert( sizeof( NtpStatus::offsetUs ) == 8 && sizeof( NtpStatus::delayUs ) == 8 ,
+               "NTP offsets must hold decades in microseconds" ) ;
+
+// What a case saw, kept in shared memory across its process
+struct Result {
+        bool synced ;
+        long errorUs ;          ///< Our clock minus the reference, at the end
+        long worstStepUs ;      ///< Largest change of the error in one second
+        uint32_t refId ;
+        bool answered[2] ;      ///< Our server replied, before and after a link drop
+} ;
+
+static Result * result = (Result *) simShared( sizeof( Result ) ) ;
+
+//_____________________________________________________________________
+//                                                               CLIENT
+
+// Our clock minus the reference UTC
+static long clockError()
+{
+        timeval tv ;
+        gettimeofday( &tv , nullptr ) ;
+        return ( (int64_t) tv.tv_sec * 1000000 + tv.tv_usec ) - simUtcUs() ;
+}
+
+// Run the client for `seconds`, called when it asks as the scheduler
+// would, watching how far the clock moves against the reference each
+// second once `watchFrom` seconds are gone; negative watches nothing
+static void runClient( long seconds , long watchFrom = -1 )
+{
+        uint64_t end = simNow() + seconds * 1000000ULL ;
+        uint64_t due = simNow() ;
+        uint64_t nextLook = watchFrom < 0 ? ~0ULL : simNow() + watchFrom * 1000000ULL ;
+        long lastError = 0 ;
+        bool looked = false ;
+
+        while ( simNow() < end ) {
+                if ( simNow() >= due ) {
+                        unsigned long ms = ntpClientService() ;
+                        due = simNow() + ( ms ? ms : 1 ) * 1000ULL ;
+                }
+                if ( simNow() >= nextLook ) {
+                        long error = clockError() ;
+                        long step = labs( error - lastError ) ;
+                        if ( looked && step > result->worstStepUs ) result->worstStepUs = step ;
+                        lastError = error ;
+                        looked = true ;
+                        nextLook += 1000000 ;
+                }
+                uint64_t until = due < nextLook ? due : nextLook ;
+                if ( until > end ) until = end ;
+                simSpend( until - simNow() ) ;
+        }
+        result->synced = getNtpStatus().synced ;
+        result->errorUs = clockError() ;
+        result->refId = getNtpStatus().refId ;
+}
+
+// Start the client on a clock `errorUs` off, in a fresh process
+static void runCase( void ( * body )() , int64_t errorUs = 0 )
+{
+        *result = Result() ;
+        fflush( stdout ) ;
+        pid_t pid = fork() ;
+        if ( !pid ) {
+                timeval tv ;
+                int64_t us = simUtcUs() + errorUs ;
+                tv.tv_sec = us / 1000000 ;
+                tv.tv_usec = us % 1000000 ;
+                settimeofday( &tv , nullptr ) ;
+
+                WiFi.begin( "wifi" , "" ) ;
+                simSpend( 2000000 ) ;
+                ntpClientSetup( names , SERVERS ) ;
+                ntpClientRestart() ;
+                body() ;
+                _exit( 0 ) ;
+        }
+        int status ;
+        waitpid( pid , &status , 0 ) ;
+        if ( !WIFEXITED( status ) || WEXITSTATUS( status ) ) {
+                fprintf( stderr , "ntp: case crashed\n" ) ;
+                exit( 2 ) ;
+        }
+}
+
+//_____________________________________________________________________
+//                                                               SERVER
+
+#define ASKER           5               // Host that queries our server
+
+// Send our server one client request from ASKER, give it a few passes,
+// and say whether a reply came back
+static bool askOurServer()
+{
+        int fd = socket( AF_INET , SOCK_DGRAM , 0 ) ;
+        sockaddr_in a = {} ;
+        a.sin_family = AF_INET ;
+        a.sin_addr.s_addr = simAddress( ASKER ) ;
+        bind( fd , (sockaddr *) &a , sizeof a ) ;
+
+        uint8_t packet[NTP_PACKET] = {} ;
+        packet[0] = 4 << 3 | 3 ;                // Version 4, client
+        a.sin_addr.s_addr = simAddress( 1 ) ;
+        a.sin_port = htons( NTP_PORT + SIM_PORT_OFFSET ) ;
+        sendto( fd , packet , sizeof packet , 0 , (sockaddr *) &a , sizeof a ) ;
+
+        for ( int i = 0 ; i < 3 ; i++ ) {
+                NtpService() ;
+                simSpend( 10000 ) ;
+        }
+        bool answered = recv( fd , packet , sizeof packet , MSG_DONTWAIT ) == NTP_PACKET ;
+        close( fd ) ;
+        return answered ;
+}
+
+// Our server answers, and answers again once the link comes back
+static void serveAcrossDrop()
+{
+        NtpSetup() ;
+        NtpService() ;
+        result->answered[0] = askOurServer() ;
+
+        simWifi( false ) ;
+        simSpend( 1000000 ) ;
+        NtpService() ;
+        simWifi( true ) ;
+        WiFi.begin( "wifi" , "" ) ;
+        simSpend( 2000000 ) ;
+        NtpService() ;
+        result->answered[1] = askOurServer() ;
+}
+
+//_____________________________________________________________________
+//                                                                CASES
+
+static void firstPoll() { runClient( 10 ) ; }
+
+static void smallStep()
+{
+        runClient( 30 ) ;
+        simStepUtc( 50000 ) ;
+        runClient( 300 , 2 ) ;
+}
+
+static void largeStep()
+{
+        runClient( 30 ) ;
+        simStepUtc( 2000000 ) ;
+        runClient( 120 ) ;
+}
+
+static void reset()
+{
+        for ( auto s : stand ) {
+                s->offsetUs = 0 ;
+                s->outUs = s->backUs = 5000 ;
+                s->stratum = 2 ;
+                s->leap = 0 ;
+                s->answering = true ;
+                s->badOrigin = false ;
+        }
+}
+
+// Only server 0 is good; the others are set up by the case, with
+// their clocks FAR_US off so any use of them shows
+static void onlyFirst()
+{
+        reset() ;
+        stand[1]->offsetUs = stand[2]->offsetUs = FAR_US ;
+}
+
+static unsigned failed = 0 ;
+
+static void expect( const char * what , bool synced , long worstStepUs = 0 , int fromServer = -1 )
+{
+        auto & r = *result ;
+        bool ok = r.synced == synced ;
+        if ( synced ) ok = ok && labs( r.errorUs ) <= SYNCED_US ;
+        if ( worstStepUs ) ok = ok && r.worstStepUs <= worstStepUs ;
+        if ( fromServer >= 0 ) ok = ok && r.refId == simAddress( stand[fromServer]->host ) ;
+        printf( "  %-36s %-10s error %8ldus  worst step %8ldus  %s\n" , what ,
+                r.synced ? "synced" : "unsynced" , r.errorUs , r.worstStepUs , ok ? "ok" : "WRONG" ) ;
+        if ( !ok ) ++failed ;
+}
+
+int main()
+{
+        setvbuf( stdout , nullptr , _IOLBF , 0 ) ;
+        simSetUtc( UTC_START ) ;
+        for ( int i = 0 ; i < SERVERS ; i++ ) stand[i] = &ntpStandIn( 2 + i , names[i] ) ;
+
+        reset() ;
+        runCase( firstPoll , -1000000000LL ) ;
+        expect( "first poll sets the clock" , true ) ;
+
+        // As after a boot: the clock reads 1970
+        runCase( firstPoll , -simUtcUs() ) ;
+        expect( "first poll from 1970 sets the clock" , true ) ;
+
+        runCase( smallStep ) ;
+        expect( "50ms reference step is slewed" , true , SLEW_US + SLEW_SLACK_US ) ;
+
+        runCase( largeStep ) ;
+        expect( "2s reference step is stepped" , true ) ;
+
+        // The closest server wins even when the others agree among
+        // themselves; their round trips are long but accepted
+        reset() ;
+        stand[1]->offsetUs = stand[2]->offsetUs = 20000 ;
+        stand[1]->outUs = stand[2]->outUs = 100000 ;
+        runCase( firstPoll ) ;
+        expect( "shortest round trip wins" , true , 0 , 0 ) ;
+
+        onlyFirst() ;
+        stand[1]->stratum = stand[2]->stratum = 0 ;
+        runCase( firstPoll ) ;
+        expect( "kiss-of-death ignored" , true , 0 , 0 ) ;
+
+        onlyFirst() ;
+        stand[1]->leap = stand[2]->leap = 3 ;
+        runCase( firstPoll ) ;
+        expect( "unsynchronized server ignored" , true , 0 , 0 ) ;
+
+        onlyFirst() ;
+        stand[1]->badOrigin = stand[2]->badOrigin = true ;
+        runCase( firstPoll ) ;
+        expect( "reply to another query ignored" , true , 0 , 0 ) ;
+
+        onlyFirst() ;
+        stand[1]->outUs = stand[2]->outUs = 300000 ;
+        stand[1]->backUs = stand[2]->backUs = 300000 ;
+        runCase( firstPoll ) ;
+        expect( "600ms round trip ignored" , true , 0 , 0 ) ;
+
+        onlyFirst() ;
+        stand[1]->answering = stand[2]->answering = false ;
+        runCase( firstPoll ) ;
+        expect( "silent servers skipped" , true , 0 , 0 ) ;
+
+        // With no usable server at all the clock is never set
+        onlyFirst() ;
+        for ( auto s : stand ) s->stratum = 0 ;
+        runCase( firstPoll ) ;
+        expect( "nothing usable, no sync" , false ) ;
+
+        runCase( serveAcrossDrop ) ;
+        bool served = result->answered[0] && result->answered[1] ;
+        printf( "  %-36s %-10s %s\n" , "our server answers after a link drop" ,
+                served ? "answered" : "silent" , served ? "ok" : "WRONG" ) ;
+        if ( !served ) ++failed ;
+
+        printf( "%s\n" , failed ? "FAIL" : "PASS" ) ;
+        return failed ? 1 : 0 ;
+}
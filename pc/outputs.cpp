@@ -0,0 +1,153 @@
+// outputs.cpp
+//
+// Each output stage backend, edge by edge
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Built once per OUTPUT_STAGE, each build with its own OutputStage.o.
+// It writes every change between every pair of line masks through
+// outputWrite() and watches the pins: the GPIO and pins backends drive
+// the lines directly, and a 74HC595 chain model here follows the shift
+// backend's data, clock and latch.  The mock backend has no pins, so
+// its recorded edges are read back instead.
+//
+// Virtual time stands still inside an edge, so the skew counted here is
+// the number of line states the world sees between the old mask and the
+// new one.  Zero means every line changed at once.  The cost is host
+// time and pin changes per edge; the ESP's cycle counts are on its
+// console and metrics.
+//
+// The check fails if an edge leaves the wrong lines raised, or if a
+// single-store backend (gpio, shift) shows a line state in between.
+
+#include <Arduino.h>
+#include "OutputStage.h"
+#include "Sim.h"
+
+#define LINES           3
+#define PASSES          20000           // Timed runs over every transition
+
+static const int pins[LINES] = { 14 , 12 , 13 } ;      // A, B, D as wired
+
+#if OUTPUT_STAGE == OUTPUT_GPIO
+#define BACKEND         "gpio"
+#define SINGLE_STORE    true
+#elif OUTPUT_STAGE == OUTPUT_PINS
+#define BACKEND         "pins"
+#define SINGLE_STORE    false
+#elif OUTPUT_STAGE == OUTPUT_SHIFT
+#define BACKEND         "shift"
+#define SINGLE_STORE    true
+#else
+#define BACKEND         "mock"
+#define SINGLE_STORE    true
+#endif
+
+//_____________________________________________________________________
+//                                                              WATCHER
+
+static unsigned lines = 0 ;             ///< Line levels the world sees
+static unsigned states = 0 ;            ///< Line states seen in this edge
+static unsigned long pinChanges = 0 ;
+
+#if OUTPUT_STAGE == OUTPUT_SHIFT
+
+static uint32_t pinLevels = 0 ;         ///< GPIO levels, bit n for GPIO n
+static uint32_t shiftChain = 0 ;        ///< 74HC595 shift stage, QA in bit 0
+
+// The chain shifts on a rising clock and copies to its outputs on a
+// rising latch
+static unsigned linesOf( uint32_t levels )
+{
+        uint32_t rose = levels & ~pinLevels ;
+        pinLevels = levels ;
+        if ( rose & ( 1UL << SHIFT_CLOCK ) )
+                shiftChain = ( shiftChain << 1 ) | ( ( levels >> SHIFT_DATA ) & 1 ) ;
+        if ( rose & ( 1UL << SHIFT_LATCH ) )
+                return shiftChain & ( ( 1u << LINES ) - 1 ) ;
+        return lines ;
+}
+
+#else
+
+static unsigned linesOf( uint32_t levels )
+{
+        unsigned seen = 0 ;
+        for ( int i = 0 ; i < LINES ; i++ )
+                if ( ( levels >> pins[i] ) & 1 ) seen |= 1u << i ;
+        return seen ;
+}
+
+#endif
+
+static void onPins( uint32_t levels )
+{
+        ++pinChanges ;
+        unsigned seen = linesOf( levels ) ;
+        if ( seen != lines ) {
+                lines = seen ;
+                ++states ;
+        }
+}
+
+// Write one edge and return the line states the world saw on the way
+static unsigned edge( unsigned mask )
+{
+        states = 0 ;
+        outputWrite( mask ) ;
+#if OUTPUT_STAGE == OUTPUT_MOCK
+        OutputEdge e ;
+        while ( readOutputEdge( e ) ) {
+                lines = e.lines ;
+                ++states ;
+        }
+#endif
+        return states ;
+}
+
+//_____________________________________________________________________
+//                                                                 MAIN
+
+int main()
+{
+        const unsigned masks = 1u << LINES ;
+        unsigned bad = 0 , between = 0 , worst = 0 , edges = 0 ;
+
+        simOnPins( onPins ) ;
+        outputSetup( pins , LINES ) ;
+        edge( 0 ) ;
+
+        for ( unsigned from = 0 ; from < masks ; from++ )
+                for ( unsigned to = 0 ; to < masks ; to++ ) {
+                        if ( from == to ) continue ;
+                        edge( from ) ;
+                        unsigned seen = edge( to ) ;
+                        ++edges ;
+                        if ( lines != to ) {
+                                if ( bad++ < 10 ) printf( "  %u to %u left lines %u\n" , from , to , lines ) ;
+                                continue ;
+                        }
+                        unsigned skew = seen ? seen - 1 : 0 ;
+                        between += skew ;
+                        if ( skew > worst ) worst = skew ;
+                        if ( skew && SINGLE_STORE && bad++ < 10 )
+                                printf( "  %u to %u passed through %u states\n" , from , to , skew ) ;
+                }
+
+        // Time the edges, with the watcher counting pin changes only
+        unsigned long changes = pinChanges ;
+        double wall = simWallSeconds() ;
+        for ( unsigned p = 0 ; p < PASSES ; p++ )
+                for ( unsigned m = 0 ; m < masks ; m++ ) edge( m ) ;
+        wall = simWallSeconds() - wall ;
+        double timed = double( PASSES ) * masks ;
+        changes = pinChanges - changes ;
+
+        printf( "%-5s  skew %u states worst, %.2f mean  cost %5.1f ns, %4.1f pin changes an edge  %s\n" ,
+                BACKEND , worst , double( between ) / edges , wall * 1e9 / timed , changes / timed ,
+                bad ? "FAIL" : "PASS" ) ;
+        return bad ? 1 : 0 ;
+}
@@ -0,0 +1,123 @@
+// restore.cpp
+//
+// Which saved face time readTime() restores after a reset or power cut
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// TimeSave keeps every minute in RTC user memory and the flash journal
+// a few minutes behind.  At startup a valid RTC record wins, then the
+// journal, then the legacy text file.  Each case below saves or damages
+// one of them and restores in a fresh boot, which for TimeSave means a
+// forked process: its open journal and save state start over, while RTC
+// memory and flash live in the world and carry over.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+#include "clock_generic.h"
+#include "TimeSave.h"
+#include "Sim.h"
+
+#define JOURNAL_FILE    "clockface.bin"
+#define LEGACY_FILE     "clockface.txt"
+#define RTC_WORDS       16              // RTC memory saved and put back whole
+
+static int * restored = (int *) simShared( sizeof( int ) ) ;
+
+//_____________________________________________________________________
+//                                                                BOOTS
+
+// Run fn in a fresh process, as the firmware after a reset
+static void boot( void ( * fn )( int ) , int arg = 0 )
+{
+        fflush( stdout ) ;
+        pid_t pid = fork() ;
+        if ( !pid ) {
+                fn( arg ) ;
+                _exit( 0 ) ;
+        }
+        int status ;
+        waitpid( pid , &status , 0 ) ;
+        if ( !WIFEXITED( status ) || WEXITSTATUS( status ) ) {
+                fprintf( stderr , "restore: boot failed\n" ) ;
+                exit( 2 ) ;
+        }
+}
+
+// Save a face time, in minutes, to RTC memory and the journal
+static void commit( int minutes ) { commitTime( 0 , minutes * 60 ) ; }
+
+// Restore the face time, in minutes or -1
+static void restore( int ) { *restored = readTime( 0 ) / 60 ; }
+
+static int restoredMinutes()
+{
+        boot( restore ) ;
+        return *restored ;
+}
+
+//_____________________________________________________________________
+//                                                                CASES
+
+static unsigned failed = 0 ;
+
+static void expect( const char * what , int want )
+{
+        int got = restoredMinutes() ;
+        printf( "  %-40s %4d" , what , got ) ;
+        if ( got == want ) {
+                printf( "\n" ) ;
+        } else {
+                printf( "  want %d\n" , want ) ;
+                ++failed ;
+        }
+}
+
+int main()
+{
+        uint32_t rtc[RTC_WORDS] ;
+
+        expect( "nothing saved" , -1 ) ;
+
+        // The old format wrote t+1
+        simWriteFile( LEGACY_FILE , "300\n301\n" , 8 ) ;
+        expect( "legacy file only" , 300 ) ;
+
+        boot( commit , 400 ) ;
+        expect( "RTC and journal agree" , 400 ) ;
+
+        // RTC memory a minute ahead of the journal, as after a reset
+        // between flash saves
+        ESP.rtcUserMemoryRead( 0 , rtc , sizeof rtc ) ;
+        boot( commit , 390 ) ;
+        ESP.rtcUserMemoryWrite( 0 , rtc , sizeof rtc ) ;
+        expect( "RTC ahead of the journal" , 400 ) ;
+
+        simRemoveFile( JOURNAL_FILE ) ;
+        expect( "RTC with the journal gone" , 400 ) ;
+
+        boot( commit , 390 ) ;
+        simPowerCut() ;
+        simPowerOn() ;
+        expect( "power cut, journal over legacy" , 390 ) ;
+
+        // One flipped bit fails the RTC record's CRC
+        boot( commit , 420 ) ;
+        ESP.rtcUserMemoryRead( 0 , rtc , sizeof rtc ) ;
+        boot( commit , 410 ) ;
+        rtc[1] ^= 1 ;
+        ESP.rtcUserMemoryWrite( 0 , rtc , sizeof rtc ) ;
+        expect( "RTC damaged, journal" , 410 ) ;
+
+        simRemoveFile( JOURNAL_FILE ) ;
+        simPowerCut() ;
+        simPowerOn() ;
+        expect( "power cut, journal gone, legacy" , 300 ) ;
+
+        printf( "%s\n" , failed ? "FAIL" : "PASS" ) ;
+        return failed ? 1 : 0 ;
+}
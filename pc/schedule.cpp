@@ -0,0 +1,128 @@
+// schedule.cpp
+//
+// The precomputed pulse schedule against the per-second protocol checks
+// it replaced
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// checkA(), checkB() and checkD() below are the IBM rules as the sketch
+// computed them every second before PulseSchedule.  The compiler checks
+// the protocol model against them over the whole dial; this program
+// checks the table the firmware reads, and secondsUntilNextPulse() against
+// a plain scan, for all MAX_TIME seconds, then times both ways.
+
+#include <Arduino.h>
+#include "clock_generic.h"
+#include "PulseSchedule.h"
+#include "Protocol.h"
+#include "Sim.h"
+
+#define PASSES          200             // Benchmark runs over the dial
+
+//_____________________________________________________________________
+//                                                  THE ORIGINAL CHECKS
+
+static constexpr int checkA( unsigned t ) {
+        unsigned s = t % 60 ;
+        unsigned m = ( t / 60 ) % 60 ;
+
+        if ( s == 0 ) return HIGH ;
+
+        // Extra pulses on even seconds 10-50 of minute 59
+        if ( m != 59 ) return LOW ;
+        if ( s < 10 || s > 50 ) return LOW ;
+        if ( s % 2 ) return LOW ;
+        return HIGH ;
+}
+
+static constexpr int checkB( unsigned t ) {
+        unsigned s = t % 60 ;
+        unsigned m = ( t / 60 ) % 60 ;
+
+        // pulse once per minute from 00 to 49
+        if ( m > 49 ) return LOW ;
+        return s == 0 ? HIGH : LOW ;
+}
+
+static constexpr int checkD( unsigned t ) {
+        return t % 60 == 0 ? HIGH : LOW ;
+}
+
+// The sketch called each from loop(), out of line
+static __attribute__(( noinline )) int callA( unsigned t ) { return checkA( t ) ; }
+static __attribute__(( noinline )) int callB( unsigned t ) { return checkB( t ) ; }
+static __attribute__(( noinline )) int callD( unsigned t ) { return checkD( t ) ; }
+
+static constexpr unsigned checkAll( unsigned t ) {
+        return ( checkA( t ) ? SIGNAL_A : 0 ) |
+               ( checkB( t ) ? SIGNAL_B : 0 ) |
+               ( checkD( t ) ? SIGNAL_D : 0 ) ;
+}
+
+//_____________________________________________________________________
+//                                                     COMPILE-TIME CHECK
+
+static constexpr bool ibmMatchesChecks() {
+        for ( unsigned t = 0 ; t < MAX_TIME ; t++ )
+                if ( ProtocolEngine< IbmProtocol >::signals( t ) != checkAll( t ) ) return false ;
+        return true ;
+}
+static_assert( ibmMatchesChecks() , "IBM protocol differs from checkA/B/D" ) ;
+
+//_____________________________________________________________________
+//                                                                 MAIN
+
+// Seconds from t to the next second raising a line in mask, the slow way
+static unsigned scanNextPulse( unsigned t , unsigned mask ) {
+        for ( unsigned n = 0 ; n < MAX_TIME ; n++ )
+                if ( checkAll( ( t + n ) % MAX_TIME ) & mask ) return n ;
+        return MAX_TIME ;
+}
+
+int main()
+{
+        static const unsigned masks[] = {
+                SIGNAL_A , SIGNAL_B , SIGNAL_D , SIGNAL_A | SIGNAL_B , SIGNAL_ALL ,
+        } ;
+        unsigned bad = 0 ;
+
+        if ( ClockProtocol::Policy::lines != IbmProtocol::lines ) {
+                printf( "Built for the %s protocol; only IBM has checkA/B/D\n" , ClockProtocol::Policy::name ) ;
+                return 0 ;
+        }
+
+        for ( unsigned t = 0 ; t < MAX_TIME ; t++ ) {
+                if ( pulseSignals( t ) != checkAll( t ) ) {
+                        if ( bad++ < 10 ) printf( "pulseSignals(%u) = %u, checks say %u\n" , t , pulseSignals( t ) , checkAll( t ) ) ;
+                }
+                for ( unsigned mask : masks ) {
+                        unsigned want = scanNextPulse( t , mask ) ;
+                        unsigned got = secondsUntilNextPulse( t , mask ) ;
+                        if ( got != want && bad++ < 10 )
+                                printf( "secondsUntilNextPulse(%u, %u) = %u, want %u\n" , t , mask , got , want ) ;
+                }
+        }
+
+        // Time both over the dial.  The sink keeps the calls.
+        volatile unsigned sink = 0 ;
+        double wall = simWallSeconds() ;
+        for ( unsigned p = 0 ; p < PASSES ; p++ )
+                for ( unsigned t = 0 ; t < MAX_TIME ; t++ )
+                        sink = sink + ( callA( t ) ? SIGNAL_A : 0 ) + ( callB( t ) ? SIGNAL_B : 0 ) + ( callD( t ) ? SIGNAL_D : 0 ) ;
+        double checks = simWallSeconds() - wall ;
+
+        wall = simWallSeconds() ;
+        for ( unsigned p = 0 ; p < PASSES ; p++ )
+                for ( unsigned t = 0 ; t < MAX_TIME ; t++ )
+                        sink = sink + pulseSignals( t ) ;
+        double table = simWallSeconds() - wall ;
+
+        double calls = double( PASSES ) * MAX_TIME ;
+        printf( "checkA/B/D    %6.1f ns a second\n" , checks * 1e9 / calls ) ;
+        printf( "pulseSignals  %6.1f ns a second\n" , table * 1e9 / calls ) ;
+        printf( "%u mismatches over %u seconds\n" , bad , MAX_TIME ) ;
+        return bad ? 1 : 0 ;
+}
@@ -0,0 +1,429 @@
+// simulate.cpp
+//
+// Days of operation in seconds: the whole firmware against a world of
+// slave movements, NTP servers, a WiFi link, a RUN switch and a supply
+// that fails
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Two movements hang on the lines: an IBM one whose cam steps it on A
+// or B, and a plain minute-impulse one on D.  Either steps at the end
+// of a pulse at least 50ms long, like a real armature.  Every second,
+// 800ms in, both faces are checked against the reference local time.
+//
+// Each disturbance in a scenario opens a grace window; wrong seconds
+// inside one are expected and only reported, as the time the face took
+// to come right.  A wrong second anywhere else fails the run.
+//
+//    simulate              run every scenario, each in a fresh process
+//    simulate <scenario>   run one; SIM_SERIAL=1 shows the console
+//
+// `simulate-nopower` is built without POWER_PIN, as the sketch is by
+// default.  Power cuts come with no warning, and the face position must
+// come back from the flash journal alone.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+#include "NtpStandIn.h"
+#include "Sim.h"
+
+// Wiring, as in the sketch; POWER_PIN comes from the Makefile
+#ifndef POWER_PIN
+#define POWER_PIN       -1
+#endif
+#define PIN_A           14
+#define PIN_B           12
+#define PIN_D           13
+#define PIN_RUN         0
+#define PIN_POWER       POWER_PIN
+
+#define TZ_RULES        "PST8PDT,M3.2.0,M11.1.0"
+#define DIAL_MINUTES    ( 12 * 60 )
+#define MIN_STEP_US     50000           // Shortest pulse an armature follows
+#define CHECK_US        800000          // Check the faces this far into each second
+#define SUPPLY_HOLD_US  100000          // Power-fail input to brown-out
+#define DRIFT_PPB       30000           // The ESP's crystal runs 30ppm fast
+#define MAX_WINDOWS     32
+#define MAX_REPORTED    10              // Stretches of wrong seconds printed
+
+//_____________________________________________________________________
+//                                                            SCENARIOS
+
+enum Action {
+        BOOT ,          ///< First power-up; only opens a window
+        RESET ,         ///< Watchdog reset
+        CUT ,           ///< Power cut for `arg` seconds
+        NTP_STEP ,      ///< Reference time steps by `arg` seconds
+        WIFI_DOWN ,     ///< WiFi gone for `arg` seconds
+        LINE_FAULT ,    ///< Lines cut for `arg` seconds, then the operator holds RUN
+        DST ,           ///< Daylight saving change; only opens a window
+} ;
+
+struct Step {
+        long at ;               ///< Seconds into the scenario
+        Action action ;
+        long arg ;
+        long grace ;            ///< Seconds the faces may be wrong from `at`
+        const char * name ;
+} ;
+
+struct Scenario {
+        const char * name ;
+        time_t start ;          ///< UTC
+        long seconds ;
+        const Step * steps ;
+        unsigned nSteps ;
+} ;
+
+#define HOUR 3600L
+
+// 2026-03-07 12:00 PST.  The clocks spring forward at +14h.
+static const Step spring[] = {
+        { 0 , BOOT , 0 , 60 , "first boot" } ,
+        { 1 * HOUR , RESET , 0 , 120 , "watchdog reset" } ,
+        { 3 * HOUR , CUT , 3 * HOUR , 300 , "3h power cut" } ,
+        { 8 * HOUR , NTP_STEP , 180 , 300 , "reference +180s" } ,
+        { 10 * HOUR , NTP_STEP , -180 , 400 , "reference -180s" } ,
+        { 14 * HOUR - 120 , DST , 0 , 300 , "spring forward" } ,
+        { 20 * HOUR , WIFI_DOWN , 2 * HOUR , 0 , "2h WiFi outage" } ,
+        { 26 * HOUR , LINE_FAULT , 300 , 120 , "5min line fault, RUN" } ,
+        { 30 * HOUR , CUT , 2 , 120 , "2s power blip" } ,
+        { 36 * HOUR , CUT , 9 * HOUR , 900 , "9h power cut" } ,
+} ;
+
+// 2026-10-31 12:00 PDT.  The clocks fall back at +14h, 01:00 PST, and
+// the power is off from 01:30 PDT to 01:30 PST: the face is right again.
+static const Step fall[] = {
+        { 0 , BOOT , 0 , 60 , "first boot" } ,
+        { 14 * HOUR - 1800 , CUT , HOUR , 120 , "1h cut over fall back" } ,
+} ;
+
+// The same day, powered through the change: the face runs round the dial
+static const Step fallRun[] = {
+        { 0 , BOOT , 0 , 60 , "first boot" } ,
+        { 14 * HOUR - 600 , DST , 0 , 1200 , "fall back" } ,
+} ;
+
+static const Scenario scenarios[] = {
+        { "spring" , 1772913600 , 72 * HOUR , spring , sizeof spring / sizeof spring[0] } ,
+        { "fall" , 1793473200 , 24 * HOUR , fall , sizeof fall / sizeof fall[0] } ,
+        { "fall-run" , 1793473200 , 24 * HOUR , fallRun , sizeof fallRun / sizeof fallRun[0] } ,
+} ;
+
+//_____________________________________________________________________
+//                                                                STATE
+
+struct Window {
+        const char * name ;
+        uint64_t from , until ;         ///< Virtual microseconds
+        uint64_t lastWrong ;            ///< 0 if the faces were never wrong
+} ;
+
+// Shared with the boots, which move the faces
+struct State {
+        const Scenario * scenario ;
+        uint64_t startUs ;              ///< Reference UTC at the start
+
+        // The movements
+        unsigned ibmFace , dFace ;      ///< Minutes past 12:00
+        uint32_t levels ;               ///< Output pins, bit n for GPIO n
+        uint64_t riseAt[32] ;
+        bool lineFault ;                ///< Pulses don't reach the movements
+        bool runHeld ;                  ///< The operator holds RUN until the faces are right
+        unsigned long steps ;
+
+        // The checks
+        Window windows[MAX_WINDOWS] ;
+        unsigned nWindows ;
+        unsigned long checks , wrong , strictWrong ;
+        uint64_t wrongSince ;           ///< Start of the stretch of wrong seconds, or 0
+        unsigned stretches ;            ///< Stretches outside the windows
+} ;
+
+static State & state = *(State *) simShared( sizeof( State ) ) ;
+
+// SIM_TRACE=1 prints every change on the lines
+static const bool trace = getenv( "SIM_TRACE" ) && atoi( getenv( "SIM_TRACE" ) ) ;
+
+// Reference local time, in minutes on the 12-hour dial
+static unsigned referenceMinute()
+{
+        time_t t = simUtcUs() / 1000000 ;
+        struct tm tm ;
+        localtime_r( &t , &tm ) ;
+        return ( tm.tm_hour % 12 ) * 60 + tm.tm_min ;
+}
+
+static void printTime( FILE * f , int64_t utcUs )
+{
+        time_t t = utcUs / 1000000 ;
+        struct tm tm ;
+        localtime_r( &t , &tm ) ;
+        char buf[40] ;
+        strftime( buf , sizeof buf , "%a %H:%M:%S %Z" , &tm ) ;
+        fprintf( f , "%s" , buf ) ;
+}
+
+// Hours and minutes of a face position
+static const char * dial( unsigned minute )
+{
+        static char text[4][16] ;
+        static unsigned next ;
+        char * t = text[next++ % 4] ;
+        snprintf( t , sizeof text[0] , "%u:%02u" , minute / 60 ? minute / 60 : 12 , minute % 60 ) ;
+        return t ;
+}
+
+//_____________________________________________________________________
+//                                                            MOVEMENTS
+
+// The IBM cam steps on A at :49-:58 and on B the rest of the hour
+static uint32_t ibmSteppingPin( unsigned face )
+{
+        return face % 60 >= 49 && face % 60 <= 58 ? 1UL << PIN_A : 1UL << PIN_B ;
+}
+
+static void pinsChanged( uint32_t levels )
+{
+        uint32_t rose = levels & ~state.levels ;
+        uint32_t fell = state.levels & ~levels ;
+        state.levels = levels ;
+
+        auto now = simNow() ;
+        for ( int pin = 0 ; pin < 32 ; pin++ )
+                if ( rose & ( 1UL << pin ) ) state.riseAt[pin] = now ;
+
+        // Only pulses long enough to pull the armature in step a face
+        uint32_t pulsed = 0 ;
+        for ( int pin = 0 ; pin < 32 ; pin++ )
+                if ( ( fell & ( 1UL << pin ) ) && now - state.riseAt[pin] >= MIN_STEP_US )
+                        pulsed |= 1UL << pin ;
+        if ( trace ) {
+                printf( "    %9.3f pins %04x" , simNow() / 1e6 , (unsigned) levels ) ;
+                if ( pulsed ) printf( " pulsed %04x" , (unsigned) pulsed ) ;
+                printf( ", faces %s %s\n" , dial( state.ibmFace ) , dial( state.dFace ) ) ;
+        }
+        if ( !pulsed || state.lineFault ) return ;
+
+        if ( pulsed & ibmSteppingPin( state.ibmFace ) ) {
+                state.ibmFace = ( state.ibmFace + 1 ) % DIAL_MINUTES ;
+                ++state.steps ;
+        }
+        if ( pulsed & ( 1UL << PIN_D ) ) state.dFace = ( state.dFace + 1 ) % DIAL_MINUTES ;
+}
+
+//_____________________________________________________________________
+//                                                               CHECKS
+
+static void openWindow( const char * name , long seconds )
+{
+        if ( state.nWindows == MAX_WINDOWS ) return ;
+        auto now = simNow() ;
+        state.windows[state.nWindows++] = { name , now , now + seconds * 1000000ULL , 0 } ;
+}
+
+// Stretch the newest window to `seconds` from now
+static void extendWindow( long seconds )
+{
+        if ( state.nWindows ) state.windows[state.nWindows - 1].until = simNow() + seconds * 1000000ULL ;
+}
+
+static void checkFaces( intptr_t )
+{
+        auto now = simNow() ;
+        unsigned right = referenceMinute() ;
+        bool ok = state.ibmFace == right && state.dFace == right ;
+        ++state.checks ;
+
+        // The operator lets go of RUN when the faces look right
+        if ( state.runHeld && ok ) {
+                state.runHeld = false ;
+                simInput( PIN_RUN , HIGH ) ;
+        }
+
+        bool strict = false ;
+        if ( !ok ) {
+                ++state.wrong ;
+                strict = true ;
+                for ( unsigned i = 0 ; i < state.nWindows ; i++ ) {
+                        auto & w = state.windows[i] ;
+                        if ( now < w.from || now > w.until ) continue ;
+                        w.lastWrong = now ;
+                        strict = false ;
+                }
+        }
+
+        // Report each stretch of unexpected wrong seconds once
+        if ( strict ) {
+                ++state.strictWrong ;
+                if ( !state.wrongSince ) {
+                        state.wrongSince = now ;
+                        if ( ++state.stretches <= MAX_REPORTED ) {
+                                printf( "  wrong from " ) ;
+                                printTime( stdout , simUtcUs() ) ;
+                                printf( ": IBM %s, D %s, time %s" , dial( state.ibmFace ) , dial( state.dFace ) , dial( right ) ) ;
+                        }
+                }
+        } else if ( state.wrongSince ) {
+                if ( state.stretches <= MAX_REPORTED )
+                        printf( ", for %llus\n" , (unsigned long long) ( now - state.wrongSince ) / 1000000 ) ;
+                state.wrongSince = 0 ;
+        }
+
+        // Next check at the same point of the next reference second
+        int64_t utc = simUtcUs() ;
+        int64_t next = ( utc / 1000000 + 1 ) * 1000000 + CHECK_US ;
+        simAt( now + ( next - utc ) , checkFaces ) ;
+}
+
+//_____________________________________________________________________
+//                                                               EVENTS
+
+static void powerDead( intptr_t ) { simPowerCut() ; }
+
+static void powerBack( intptr_t )
+{
+        simInput( PIN_POWER , HIGH ) ;
+        simPowerOn() ;
+}
+
+static void wifiBack( intptr_t ) { simWifi( true ) ; }
+
+static void lineRepaired( intptr_t )
+{
+        state.lineFault = false ;
+        state.runHeld = true ;
+        simInput( PIN_RUN , LOW ) ;
+}
+
+static void runStep( intptr_t i )
+{
+        auto & step = state.scenario->steps[i] ;
+        openWindow( step.name , step.grace ) ;
+
+        switch ( step.action ) {
+        case BOOT :
+        case DST :
+                break ;
+        case RESET :
+                simReset() ;
+                break ;
+        case CUT :
+                // The supply monitor trips, then the regulator drops out.
+                // Unwired, the ESP just dies.
+                extendWindow( step.arg + step.grace ) ;
+                simAt( simNow() + step.arg * 1000000ULL , powerBack ) ;
+                if ( PIN_POWER < 0 ) {
+                        simPowerCut() ;
+                } else {
+                        simInput( PIN_POWER , LOW ) ;
+                        simAt( simNow() + SUPPLY_HOLD_US , powerDead ) ;
+                }
+                break ;
+        case NTP_STEP :
+                simStepUtc( step.arg * 1000000LL ) ;
+                break ;
+        case WIFI_DOWN :
+                extendWindow( 0 ) ;
+                simWifi( false ) ;
+                simAt( simNow() + step.arg * 1000000ULL , wifiBack ) ;
+                break ;
+        case LINE_FAULT :
+                extendWindow( step.arg + step.grace ) ;
+                state.lineFault = true ;
+                simAt( simNow() + step.arg * 1000000ULL , lineRepaired ) ;
+                break ;
+        }
+}
+
+static void scenarioDone( intptr_t ) { simDone() ; }
+
+//_____________________________________________________________________
+//                                                                 MAIN
+
+// Put the face on the right time, the way a clock is commissioned: the
+// old text file the sketch still reads holds the face minute plus one
+static void installFace( unsigned minute )
+{
+        char text[16] ;
+        int n = snprintf( text , sizeof text , "%u\n" , minute + 1 ) ;
+        simWriteFile( "clockface.txt" , text , n ) ;
+        state.ibmFace = state.dFace = minute ;
+}
+
+static int runScenario( const Scenario & s )
+{
+        state.scenario = &s ;
+        simSetUtc( s.start ) ;
+        state.startUs = simUtcUs() ;
+        simDrift( DRIFT_PPB ) ;
+        simOnPins( pinsChanged ) ;
+
+        ntpStandIn( 2 , "0.pool.ntp.org" ) ;
+        ntpStandIn( 3 , "1.pool.ntp.org" ).outUs = 20000 ;
+        ntpStandIn( 4 , "2.pool.ntp.org" ).backUs = 40000 ;
+
+        installFace( referenceMinute() ) ;
+
+        for ( unsigned i = 0 ; i < s.nSteps ; i++ )
+                simAt( s.steps[i].at * 1000000ULL , runStep , i ) ;
+        simAt( CHECK_US , checkFaces ) ;
+        simAt( s.seconds * 1000000ULL , scenarioDone ) ;
+
+        printf( "%s: %ld hours from " , s.name , s.seconds / HOUR ) ;
+        printTime( stdout , state.startUs ) ;
+        printf( "\n" ) ;
+        fflush( stdout ) ;
+
+        auto wall = simWallSeconds() ;
+        while ( simIdle() ) simBoot() ;
+        wall = simWallSeconds() - wall ;
+
+        for ( unsigned i = 0 ; i < state.nWindows ; i++ ) {
+                auto & w = state.windows[i] ;
+                printf( "  %-24s " , w.name ) ;
+                if ( !w.lastWrong ) printf( "never wrong\n" ) ;
+                else printf( "right %llus after it began\n" , (unsigned long long) ( w.lastWrong - w.from ) / 1000000 + 1 ) ;
+        }
+        printf( "  %u boots, %lu of %lu seconds wrong, %lu outside the windows\n" ,
+                simBoots() , state.wrong , state.checks , state.strictWrong ) ;
+        printf( "  %.0f sim-hours/s (%.1fs)\n" , s.seconds / (double) HOUR / wall , wall ) ;
+
+        bool pass = !state.strictWrong && state.checks >= (unsigned long) s.seconds - 1 ;
+        printf( "%s %s\n" , pass ? "PASS" : "FAIL" , s.name ) ;
+        return pass ? 0 : 1 ;
+}
+
+int main( int argc , char ** argv )
+{
+        setenv( "TZ" , TZ_RULES , 1 ) ;
+        tzset() ;
+        setvbuf( stdout , nullptr , _IOLBF , 0 ) ;
+
+        if ( argc > 1 ) {
+                for ( auto & s : scenarios )
+                        if ( !strcmp( argv[1] , s.name ) ) return runScenario( s ) ;
+                fprintf( stderr , "Unknown scenario %s\n" , argv[1] ) ;
+                return 2 ;
+        }
+
+        // Each scenario needs a fresh world
+        int failed = 0 ;
+        for ( auto & s : scenarios ) {
+                fflush( stdout ) ;
+                pid_t pid = fork() ;
+                if ( !pid ) {
+                        execl( "/proc/self/exe" , argv[0] , s.name , (char *) nullptr ) ;
+                        _exit( 2 ) ;
+                }
+                int status ;
+                waitpid( pid , &status , 0 ) ;
+                if ( !WIFEXITED( status ) || WEXITSTATUS( status ) ) ++failed ;
+        }
+        return failed ? 1 : 0 ;
+}
@@ -0,0 +1,94 @@
+// wakeups.cpp
+//
+// How often the scheduler wakes up, with the whole sketch running
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Built twice: `wakeups` with the deadline scheduler, and `wakeups-busy`
+// with SCHEDULER_BUSY_POLL, which runs every task on every pass like the
+// old service() loop.  Each boots the sketch against NTP stand-ins, lets
+// it sync and settle, then reads getWakeupRate() every second: the same
+// figure the 'w' key and the clock_wakeups_per_second metric show.
+//
+// A pass of loop() costs Sim.cpp's LOOP_US of virtual time, so the
+// busy-polled rate is set by that figure, as it is set by the cost of a
+// pass on the ESP.  The deadline scheduler's rate comes from the tasks'
+// own deadlines; most of it is the NTP server, which reads UDP every 10ms
+// because a request's receive timestamp is taken when it is read.  The
+// deadline build fails if it wakes more than MAX_RATE times in any
+// second.
+
+#include <Arduino.h>
+#include "NtpStandIn.h"
+#include "Scheduler.h"
+#include "Sim.h"
+
+#define UTC_START       1767268800L     // 2026-01-01 12:00:00 UTC
+#define TZ_RULES        "PST8PDT,M3.2.0,M11.1.0"
+#define SETTLE          60              // Seconds to sync and settle
+#define MEASURE         120             // Seconds measured
+#define MAX_RATE        250             // Most wakeups a second allowed
+
+#ifdef SCHEDULER_BUSY_POLL
+#define MODE            "busy-polled"
+#else
+#define MODE            "deadline"
+#endif
+
+struct Rates {
+        unsigned long total ;
+        unsigned seconds ;
+        unsigned lowest , highest ;
+} ;
+
+static Rates * rates = (Rates *) simShared( sizeof( Rates ) ) ;
+
+// Once a second, inside the boot
+static void sample( intptr_t n )
+{
+        unsigned rate = getWakeupRate() ;
+        auto & r = *rates ;
+        if ( !r.seconds || rate < r.lowest ) r.lowest = rate ;
+        if ( rate > r.highest ) r.highest = rate ;
+        r.total += rate ;
+        ++r.seconds ;
+        if ( n > 1 ) simAt( simNow() + 1000000 , sample , n - 1 ) ;
+}
+
+static void finish( intptr_t ) { simDone() ; }
+
+int main()
+{
+        setenv( "TZ" , TZ_RULES , 1 ) ;
+        tzset() ;
+        simSetUtc( UTC_START ) ;
+
+        ntpStandIn( 2 , "0.pool.ntp.org" ) ;
+        ntpStandIn( 3 , "1.pool.ntp.org" ) ;
+        ntpStandIn( 4 , "2.pool.ntp.org" ) ;
+
+        // Commission the face on the right minute, as simulate does
+        time_t now = UTC_START ;
+        struct tm lt ;
+        localtime_r( &now , &lt ) ;
+        char text[16] ;
+        int n = snprintf( text , sizeof text , "%d\n" , lt.tm_hour % 12 * 60 + lt.tm_min + 1 ) ;
+        simWriteFile( "clockface.txt" , text , n ) ;
+
+        simAt( SETTLE * 1000000ULL , sample , MEASURE ) ;
+        simAt( ( SETTLE + MEASURE + 1 ) * 1000000ULL , finish ) ;
+        while ( simIdle() ) simBoot() ;
+
+        auto & r = *rates ;
+        bool bad = !r.seconds ;
+#ifndef SCHEDULER_BUSY_POLL
+        bad = bad || r.highest > MAX_RATE ;
+#endif
+        printf( "%-11s  %7.1f wakeups/s mean, %u to %u  %s\n" , MODE ,
+                r.seconds ? (double) r.total / r.seconds : 0.0 , r.lowest , r.highest ,
+                bad ? "FAIL" : "PASS" ) ;
+        return bad ? 1 : 0 ;
+}
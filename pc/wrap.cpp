@@ -0,0 +1,143 @@
+// wrap.cpp
+//
+// The time base, the LED and the scheduler across the 32-bit wraps of
+// micros() and millis()
+//
+//    Master Clock - Drives an IBM Impulse Secondary clock movement
+//    using the International Business Machine Time Protocols,
+//    Service Instructions No. 230, April 1, 1938,Form 231-8884-0
+//    By Phil Hord,  This code is in the public domain Sept 9, 2013
+//
+// Host longs are 64 bits wide, so micros() and millis() are cut to 32
+// bits here as on the ESP, and start just short of their wrap.  micros()
+// wraps every 71 minutes and millis() every 49 days.
+//
+// monoNow() must follow virtual time exactly through four wraps of
+// micros(), a deadline set before a wrap must arrive on time after it,
+// and the LED must flicker in even 100ms steps through one.  Then the
+// scheduler must run a task at its interval through the millis() wrap.
+// Code that keeps millis() in an unsigned long only wraps right here if
+// it says uint32_t, as Scheduler.cpp does.
+
+#include <Arduino.h>
+#include "clock_generic.h"
+#include "Scheduler.h"
+#include "Timer.h"
+#include "Sim.h"
+
+#define WRAP            ( 1ULL << 32 )
+#define TASK_MS         250
+
+static unsigned failed = 0 ;
+
+#define CHECK( what , ok ) do { \
+        if ( !( ok ) && failed++ < 10 ) printf( "  %s at micros() %lu\n" , what , micros() ) ; \
+} while ( 0 )
+
+//_____________________________________________________________________
+//                                                               MICROS
+
+static uint64_t startSim ;
+static Instant startMono ;
+
+// monoNow() has moved exactly as far as virtual time
+static void checkMono()
+{
+        CHECK( "monoNow() off virtual time" , monoNow().us - startMono.us == simNow() - startSim ) ;
+}
+
+static void spend( uint64_t us )
+{
+        simSpend( us ) ;
+        checkMono() ;
+}
+
+// LED levels at each change, and when
+static uint64_t ledAt[16] ;
+static unsigned ledChanges = 0 ;
+static int ledLevel = -1 ;
+
+static void onPins( uint32_t levels )
+{
+        int level = ( levels >> BUILTIN_LED ) & 1 ;
+        if ( level != ledLevel && ledChanges < 16 ) ledAt[ledChanges++] = simNow() ;
+        ledLevel = level ;
+}
+
+static void checkLed()
+{
+        // Flicker three times over a wrap: six changes 100ms apart
+        simOnPins( onPins ) ;
+        showActivity( 3 ) ;
+        for ( int i = 0 ; i < 20 ; i++ ) spend( ledService() * 1000ULL ) ;
+
+        CHECK( "LED changed too few times" , ledChanges >= 6 ) ;
+        for ( unsigned i = 1 ; i < 6 && i < ledChanges ; i++ )
+                CHECK( "LED step not 100ms" , ledAt[i] - ledAt[i - 1] == 100000 ) ;
+        simOnPins( nullptr ) ;
+}
+
+static void checkDeadline()
+{
+        // Arrive 3s before the next wrap, and set a deadline 5s out
+        spend( WRAP - 3000000 - micros() ) ;
+        Instant deadline = monoNow() + secs( 5 ) ;
+
+        spend( 4999000 ) ;
+        CHECK( "deadline early" , !reached( deadline ) ) ;
+        CHECK( "timeUntil() wrong" , timeUntil( deadline ).us == 1000 ) ;
+        CHECK( "msUntil() wrong" , msUntil( deadline ) == 1 ) ;
+
+        spend( 1000 ) ;
+        CHECK( "deadline late" , reached( deadline ) ) ;
+        CHECK( "msUntil() after the deadline" , msUntil( deadline ) == 0 ) ;
+}
+
+//_____________________________________________________________________
+//                                                               MILLIS
+
+static uint32_t lastRun = 0 ;
+static unsigned runs = 0 ;
+
+static unsigned long task()
+{
+        uint32_t now = millis() ;
+        if ( runs++ ) CHECK( "task interval wrong" , now - lastRun == TASK_MS ) ;
+        lastRun = now ;
+        return TASK_MS ;
+}
+
+static void checkScheduler()
+{
+        // 5s before millis() wraps; micros() is at a wrap too
+        simBootMicros( WRAP * 1000 - 5000000 ) ;
+        addTask( task , "wrap" ) ;
+
+        uint64_t end = simNow() + 10000000 ;
+        while ( simNow() < end ) runTasks() ;
+        CHECK( "task ran the wrong number of times" , runs == 10000 / TASK_MS || runs == 10000 / TASK_MS + 1 ) ;
+}
+
+//_____________________________________________________________________
+//                                                                 MAIN
+
+int main()
+{
+        simWrap32( true ) ;
+        simBootMicros( WRAP - 250000 ) ;
+        startSim = simNow() ;
+        startMono = monoNow() ;
+
+        checkLed() ;
+        checkDeadline() ;
+
+        // Two more wraps in minute steps, after the ones the LED and the
+        // deadline crossed
+        for ( int i = 0 ; i < 3 * 60 ; i++ ) spend( 60000000 ) ;
+        CHECK( "wraps missed" , monoNow().us >> 32 == 4 ) ;
+
+        checkScheduler() ;
+
+        printf( "%s\n" , failed ? "FAIL" : "PASS" ) ;
+        return failed ? 1 : 0 ;
+}